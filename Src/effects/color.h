@@ -0,0 +1,38 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Colour wheel and HSV colours for the effects
+
+  Licence: MIT License
+
+*/
+
+#ifndef COLOR_H_
+#define COLOR_H_
+
+#include <stdint.h>
+
+// Colour wheel 0 - 255, 0x00RRGGBB
+extern const uint32_t wheelTable[256];
+
+uint32_t Wheel(uint8_t WheelPos);
+uint32_t hsv2rgb(uint8_t hue, uint8_t saturation, uint8_t value);
+
+// Hue in 8.8 fixed point, walk the wheel in the steps shorter than one entry.
+// The step is computed once, the pixel loop only adds. Zero pixels, like an unset
+// rainbow length, is taken as one, the whole turn per pixel.
+static inline uint32_t hue_step(uint32_t pixelsPerTurn)
+{
+	if(pixelsPerTurn == 0)
+		pixelsPerTurn = 1;
+
+	return 0x10000 / pixelsPerTurn;
+}
+
+static inline uint32_t hue_color(uint32_t hue)
+{
+	return wheelTable[(hue >> 8) & 0xFF];
+}
+
+#endif /* COLOR_H_ */
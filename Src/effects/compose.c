@@ -0,0 +1,138 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Compositing of layer framebuffers with alpha and blend modes
+
+  Licence: MIT License
+
+*/
+
+#include "compose.h"
+#include "fixmath.h"
+#include "effect.h"
+
+HAL_StatusTypeDef compose_init(Compositor *compositor)
+{
+	uint32_t i;
+
+	if(compositor->output == NULL || ((uint32_t)compositor->output & 0x03) || (compositor->size & 0x03))
+		return HAL_ERROR;
+
+	for( i = 0; i < compositor->layerCount; i++ )
+	{
+		Layer *layer = &compositor->layers[i];
+
+		if(layer->frameBuffer == NULL || ((uint32_t)layer->frameBuffer & 0x03) || layer->mode > BLEND_MAX)
+			return HAL_ERROR;
+
+		// Everything is composed the first time
+		layer->dirtyStart = 0;
+		layer->dirtyEnd = compositor->size;
+	}
+
+	return HAL_OK;
+}
+
+// Bytes of the layer changed, the dirty range grows over them
+void compose_mark_dirty(Layer *layer, uint32_t start, uint32_t size)
+{
+	if(layer->dirtyStart >= layer->dirtyEnd)
+	{
+		layer->dirtyStart = start;
+		layer->dirtyEnd = start + size;
+		return;
+	}
+
+	if(start < layer->dirtyStart)
+		layer->dirtyStart = start;
+	if(start + size > layer->dirtyEnd)
+		layer->dirtyEnd = start + size;
+}
+
+// Four bytes of the layer over four bytes below it
+static inline uint32_t compose_blend(uint32_t below, uint32_t layer, uint32_t mode, uint32_t fraction)
+{
+	uint32_t blended;
+
+	switch(mode)
+	{
+	case BLEND_ADD:			blended = qadd8x4(below, layer); break;
+	case BLEND_MULTIPLY:	blended = mul8x4(below, layer); break;
+	case BLEND_SCREEN:		blended = ~mul8x4(~below, ~layer); break;
+	case BLEND_MAX:			blended = max8x4(below, layer); break;
+	default:				blended = layer; break;
+	}
+
+	if(fraction == 256)
+		return blended;
+
+	return lerp8x4(below, blended, fraction);
+}
+
+// Compose the bytes changed in any layer, the rest of the output stays.
+// Returns 1 when the output changed.
+uint8_t compose(Compositor *compositor)
+{
+	uint32_t start = compositor->size;
+	uint32_t end = 0;
+	uint32_t i, j;
+
+	// Union of the dirty ranges, the blending is not reversible so the range
+	// is composed again from all the layers
+	for( i = 0; i < compositor->layerCount; i++ )
+	{
+		Layer *layer = &compositor->layers[i];
+
+		if(layer->dirtyStart < layer->dirtyEnd)
+		{
+			if(layer->dirtyStart < start)
+				start = layer->dirtyStart;
+			if(layer->dirtyEnd > end)
+				end = layer->dirtyEnd;
+		}
+
+		layer->dirtyStart = 0;
+		layer->dirtyEnd = 0;
+	}
+
+	if(end > compositor->size)
+		end = compositor->size;
+	if(start >= end)
+		return 0;
+
+	// Whole words
+	start &= ~0x03;
+	end = (end + 3) & ~0x03;
+
+	uint32_t *output = (uint32_t *)(compositor->output + start);
+	uint32_t words = (end - start) / 4;
+
+	for( j = 0; j < words; j++ )
+	{
+		uint32_t pixel = 0;
+
+		for( i = 0; i < compositor->layerCount; i++ )
+		{
+			const Layer *layer = &compositor->layers[i];
+			const uint32_t *source = (const uint32_t *)(layer->frameBuffer + start);
+
+			// Alpha 255 is the fraction 256, the layer is taken completely
+			pixel = compose_blend(pixel, source[j], layer->mode, layer->alpha + (layer->alpha >> 7));
+		}
+
+		output[j] = pixel;
+	}
+
+	return 1;
+}
+
+static uint8_t compose_render(EffectInstance *instance)
+{
+	return compose(instance->state);
+}
+
+const Effect effectCompose = {
+	.name = "compose",
+	.render = compose_render
+};
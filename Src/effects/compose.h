@@ -0,0 +1,49 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Compositing of layer framebuffers with alpha and blend modes
+
+  Licence: MIT License
+
+*/
+
+#ifndef COMPOSE_H_
+#define COMPOSE_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+typedef enum BlendMode {
+	BLEND_NORMAL = 0,	// layer over the layers below
+	BLEND_ADD,			// saturated sum, light effects
+	BLEND_MULTIPLY,		// darkens, masks
+	BLEND_SCREEN,		// lightens, inverse of the multiply
+	BLEND_MAX			// brighter of the two
+} BlendMode;
+
+// Layer has the same format and size as the output, all buffers
+// have to be aligned to 4 bytes
+typedef struct Layer {
+	const uint8_t *frameBuffer;
+	uint8_t alpha;		// 255 is opaque
+	uint8_t mode;		// BlendMode
+
+	// Changed bytes since the last compositing, see compose_mark_dirty()
+	uint32_t dirtyStart;
+	uint32_t dirtyEnd;
+} Layer;
+
+typedef struct Compositor {
+	uint8_t *output;
+	uint32_t size;			// bytes of the output and every layer, multiple of 4
+	Layer *layers;			// the first one is the bottom
+	uint32_t layerCount;
+} Compositor;
+
+HAL_StatusTypeDef compose_init(Compositor *compositor);
+void compose_mark_dirty(Layer *layer, uint32_t start, uint32_t size);
+uint8_t compose(Compositor *compositor);
+
+#endif /* COMPOSE_H_ */
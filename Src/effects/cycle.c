@@ -0,0 +1,25 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Palette colour cycling effect, the framebuffer is not rendered at all
+
+  Licence: MIT License
+
+*/
+
+#include "effect.h"
+
+static uint8_t cycle_render(EffectInstance *instance)
+{
+	CycleState *state = instance->state;
+
+	instance->item->paletteOffset += state->step;
+
+	return state->step != 0;
+}
+
+const Effect effectCycle = {
+	.name = "cycle",
+	.render = cycle_render
+};
@@ -0,0 +1,52 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Random dots effect
+
+  Licence: MIT License
+
+*/
+
+#include "effect.h"
+#include "fade.h"
+
+static void dots_init(EffectInstance *instance)
+{
+	DotsState *state = instance->state;
+
+	random_seed(&state->random, state->seed);
+}
+
+static uint8_t dots_render(EffectInstance *instance)
+{
+	DotsState *state = instance->state;
+	uint8_t *frameBuffer = instance->frameBuffer;
+	uint32_t pixels = instance->frameBufferSize / 3;
+	uint32_t i, mask = 0;
+
+	// Whole framebuffer fades four bytes at once
+	fade_scale(frameBuffer, instance->frameBufferSize, state->fade);
+
+	// One random mask decides 32 pixels
+	for( i = 0; i < pixels; i++, mask >>= 1)
+	{
+		if((i & 0x1F) == 0)
+			mask = random_mask(&state->random, state->density);
+
+		if(mask & 0x01)
+		{
+			frameBuffer[i*3 + 0] = 255;
+			frameBuffer[i*3 + 1] = 255;
+			frameBuffer[i*3 + 2] = 255;
+		}
+	}
+
+	return 1;
+}
+
+const Effect effectDots = {
+	.name = "dots",
+	.init = dots_init,
+	.render = dots_render
+};
@@ -0,0 +1,143 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Effect framework, effect descriptors and their running instances
+
+  Licence: MIT License
+
+*/
+
+#include <string.h>
+
+#include "effect.h"
+
+// Registry of the known effects, add new effect descriptors here
+static const Effect * const effectRegistry[] = {
+	&effectRainbow,
+	&effectDots,
+	&effectCycle,
+	&effectCompose,
+	&effectTransition,
+	&effectInterpolate
+};
+
+#define EFFECT_REGISTRY_COUNT (sizeof(effectRegistry) / sizeof(effectRegistry[0]))
+
+// Effect descriptor by its name, NULL when there is no such effect
+const Effect *effect_find(const char *name)
+{
+	uint32_t i;
+
+	for( i = 0; i < EFFECT_REGISTRY_COUNT; i++ )
+	{
+		if(strcmp(effectRegistry[i]->name, name) == 0)
+			return effectRegistry[i];
+	}
+
+	return NULL;
+}
+
+// Assign the default output and initialize the effect states
+void effect_init(EffectInstance *instances, uint32_t count)
+{
+	uint32_t i;
+
+	for( i = 0; i < count; i++ )
+	{
+		EffectInstance *instance = &instances[i];
+
+		if(instance->frameBuffer == NULL && instance->item)
+		{
+			instance->frameBuffer = instance->item->frameBufferPointer;
+			instance->frameBufferSize = instance->item->frameBufferSize;
+		}
+
+		instance->frameBufferCapacity = instance->frameBufferSize;
+		instance->cached = 0;
+
+		// The first frame is rendered right away
+		instance->timestamp = timebase_us();
+		instance->previous = instance->timestamp;
+		instance->delta = 0;
+
+		if(instance->effect->init)
+			instance->effect->init(instance);
+	}
+}
+
+// Render one frame of the instance. Periodic effect renders one period only
+// after the invalidation, the other frames are the item offset rotation.
+uint8_t effect_render(EffectInstance *instance)
+{
+	const Effect *effect = instance->effect;
+
+	// The period is repeated by the item, without it the effect renders every frame
+	if(effect->periodSize == NULL || instance->item == NULL)
+		return effect->render(instance);
+
+	if(instance->cached)
+	{
+		if(instance->scroll == 0)
+			return 0;
+
+		ws2812b_item_scroll(instance->item, instance->scroll);
+		return 1;
+	}
+
+	uint32_t size = effect->periodSize(instance);
+
+	// Longer period than the framebuffer is rendered as the normal effect
+	if(size == 0 || size > instance->frameBufferCapacity)
+		size = instance->frameBufferCapacity;
+
+	instance->frameBufferSize = size;
+	instance->item->frameBufferSize = size;
+	instance->item->frameBufferOffset = 0;
+	instance->cached = 1;
+
+	return effect->render(instance);
+}
+
+// Render the instances whose period elapsed, returns 1 when any output changed
+// and the new transfer is needed. Call it when the transfer is complete.
+uint8_t effect_handle(EffectInstance *instances, uint32_t count)
+{
+	uint32_t now = timebase_us();
+	uint8_t changed = 0;
+	uint32_t i;
+
+	for( i = 0; i < count; i++ )
+	{
+		EffectInstance *instance = &instances[i];
+
+		// Not yet, the difference is negative
+		if((now - instance->timestamp) & 0x80000000)
+			continue;
+
+		// Fixed timestep, the next frame is planned from the planned time of this one.
+		// After a long delay the missed frames are skipped, not rendered in a burst.
+		instance->timestamp += instance->period;
+		if(!((now - instance->timestamp) & 0x80000000))
+			instance->timestamp = now + instance->period;
+
+		instance->delta = now - instance->previous;
+		instance->previous = now;
+
+		if(!effect_render(instance))
+			continue;
+
+		if(instance->layer)
+			compose_mark_dirty(instance->layer, instance->frameBuffer - instance->layer->frameBuffer, instance->frameBufferSize);
+
+		changed = 1;
+	}
+
+	return changed;
+}
+
+// Parameters of the periodic effect changed, render the period again
+void effect_invalidate(EffectInstance *instance)
+{
+	instance->cached = 0;
+}
@@ -0,0 +1,121 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Effect framework, effect descriptors and their running instances
+
+  Licence: MIT License
+
+*/
+
+#ifndef EFFECT_H_
+#define EFFECT_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+#include "../ws2812b/ws2812b.h"
+#include "../timebase.h"
+#include "random.h"
+#include "color.h"
+#include "compose.h"
+#include "transition.h"
+
+// Every kind of effect has one constant descriptor. The instances of the effect
+// keep their own state, so one effect can run on many outputs with different parameters.
+//
+// Usage:
+//
+//	RainbowState rainbow = { .length = 15 };
+//	EffectInstance effects[] = {
+//		{ .effect = &effectRainbow, .state = &rainbow, .item = &ws2812b.item[0], .period = 10000, .scroll = 1 },
+//	};
+//
+//	timebase_init();
+//	effect_init(effects, 1);
+//	...
+//	if(ws2812b.transferComplete && effect_handle(effects, 1))
+//		start the transfer
+
+struct EffectInstance;
+
+typedef struct Effect {
+	const char *name;
+	// Optional, called once by effect_init()
+	void (*init)(struct EffectInstance *instance);
+	// Render the next frame, returns 1 when the output changed
+	uint8_t (*render)(struct EffectInstance *instance);
+	// Optional for periodic effects, bytes of one period of the output. The period is
+	// rendered only once into the start of the framebuffer, the item repeats it over
+	// the strip and the frames are only scrolled by the item offset.
+	uint32_t (*periodSize)(struct EffectInstance *instance);
+} Effect;
+
+typedef struct EffectInstance {
+	const Effect *effect;
+	void *state;				// parameters and state of the effect, like RainbowState
+	WS2812_BufferItem *item;	// output channel of the instance
+	uint8_t *frameBuffer;		// rendered part of the framebuffer, NULL means the whole item framebuffer
+	uint32_t frameBufferSize;
+	uint32_t period;			// us between the frames
+	uint32_t timestamp;			// timebase of the next frame
+	uint32_t previous;			// timebase of the last frame
+	uint32_t delta;				// real us since the last frame, for the effects with the variable step
+	Layer *layer;				// optional, the rendered bytes are marked dirty in this compositor layer
+
+	// Periodic effects
+	int32_t scroll;				// pixels per frame
+	uint8_t cached;				// the period is rendered, clear it by effect_invalidate()
+	uint32_t frameBufferCapacity;
+} EffectInstance;
+
+// Built-in effects
+// ****************
+
+// Rainbow in XRGB framebuffer, periodic, move it by the instance scroll
+typedef struct RainbowState {
+	uint32_t length;	// LEDs of one rainbow period
+	uint16_t phase;		// hue of the first LED, 65536 is the full turn
+} RainbowState;
+
+// Random white dots fading out in RGB framebuffer
+typedef struct DotsState {
+	uint8_t density;		// LED lights up with the probability 1 / 2^density every frame
+	uint8_t fade;			// brightness is multiplied by (fade + 1) / 256 every frame
+	uint32_t seed;			// the same seed repeats the same frames
+	Random random;
+} DotsState;
+
+// Rotation of the item palette, PAL8 and PAL4 formats
+typedef struct CycleState {
+	uint8_t step;		// palette entries per frame
+} CycleState;
+
+// Keyframes of the slow source effect blended at the output rate of the instance
+typedef struct InterpolateState {
+	struct EffectInstance *source;
+	uint32_t keyframePeriod;	// us between the keyframes rendered by the source
+	uint8_t *previous;			// two keyframe buffers of the output size, aligned to 4 bytes
+	uint8_t *next;
+	uint32_t keyTime;			// timebase of the last keyframe
+} InterpolateState;
+
+extern const Effect effectRainbow;
+extern const Effect effectDots;
+extern const Effect effectCycle;
+extern const Effect effectInterpolate;
+
+// Compositor as the state, put it after the instances rendering its layers
+extern const Effect effectCompose;
+// TransitionState as the state, see transition.h
+extern const Effect effectTransition;
+
+// Public functions
+// ****************
+const Effect *effect_find(const char *name);
+void effect_init(EffectInstance *instances, uint32_t count);
+uint8_t effect_handle(EffectInstance *instances, uint32_t count);
+uint8_t effect_render(EffectInstance *instance);
+void effect_invalidate(EffectInstance *instance);
+
+#endif /* EFFECT_H_ */
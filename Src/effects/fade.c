@@ -0,0 +1,98 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Fading of whole framebuffers, four bytes at once
+
+  Licence: MIT License
+
+*/
+
+#include "fade.h"
+#include "fixmath.h"
+
+// The bytes before the first aligned word and after the last one are
+// processed one by one, the rest by whole words. Any framebuffer format
+// works, every byte is one colour component.
+
+void fade_scale(uint8_t *buffer, uint32_t size, uint8_t scale)
+{
+	while(size && ((uint32_t)buffer & 0x03))
+	{
+		*buffer = scale8(*buffer, scale);
+		buffer++;
+		size--;
+	}
+
+	uint32_t *word = (uint32_t *)buffer;
+	uint32_t words = size / 4;
+
+	while(words--)
+	{
+		*word = scale8x4(*word, scale);
+		word++;
+	}
+
+	buffer = (uint8_t *)word;
+	size &= 0x03;
+
+	while(size--)
+	{
+		*buffer = scale8(*buffer, scale);
+		buffer++;
+	}
+}
+
+void fade_subtract(uint8_t *buffer, uint32_t size, uint8_t amount)
+{
+	uint32_t amount4 = amount * 0x01010101;
+
+	while(size && ((uint32_t)buffer & 0x03))
+	{
+		*buffer = qsub8(*buffer, amount);
+		buffer++;
+		size--;
+	}
+
+	uint32_t *word = (uint32_t *)buffer;
+	uint32_t words = size / 4;
+
+	while(words--)
+	{
+		*word = qsub8x4(*word, amount4);
+		word++;
+	}
+
+	buffer = (uint8_t *)word;
+	size &= 0x03;
+
+	while(size--)
+	{
+		*buffer = qsub8(*buffer, amount);
+		buffer++;
+	}
+}
+
+void fade_crossfade(uint8_t *output, const uint8_t *from, const uint8_t *to, uint32_t size, uint32_t fraction)
+{
+	uint32_t i = 0;
+
+	if(((uint32_t)output & 0x03) == 0)
+	{
+		uint32_t *output4 = (uint32_t *)output;
+		const uint32_t *from4 = (const uint32_t *)from;
+		const uint32_t *to4 = (const uint32_t *)to;
+
+		for( ; i < size / 4; i++ )
+		{
+			output4[i] = lerp8x4(from4[i], to4[i], fraction);
+		}
+
+		i *= 4;
+	}
+
+	for( ; i < size; i++ )
+	{
+		output[i] = lerp8(from[i], to[i], fraction);
+	}
+}
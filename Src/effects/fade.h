@@ -0,0 +1,26 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Fading of whole framebuffers, four bytes at once
+
+  Licence: MIT License
+
+*/
+
+#ifndef FADE_H_
+#define FADE_H_
+
+#include <stdint.h>
+
+// Exponential decay, every byte is multiplied by (scale + 1) / 256
+void fade_scale(uint8_t *buffer, uint32_t size, uint8_t scale);
+
+// Linear decay, the amount is subtracted from every byte, stops at zero
+void fade_subtract(uint8_t *buffer, uint32_t size, uint8_t amount);
+
+// Blend of two buffers, the fraction 0 is from and 256 is to. The sources have
+// to be aligned to 4 bytes, the output is processed by words when it is aligned too.
+void fade_crossfade(uint8_t *output, const uint8_t *from, const uint8_t *to, uint32_t size, uint32_t fraction);
+
+#endif /* FADE_H_ */
@@ -0,0 +1,19 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Fixed point helpers for the effects
+
+  Licence: MIT License
+
+*/
+
+#include "fixmath.h"
+
+// 127 * sin(i * pi / 128)
+const uint8_t sinTable[65] = {
+    0,  3,  6,  9, 12, 16, 19, 22, 25, 28, 31, 34, 37, 40, 43, 46,
+   49, 51, 54, 57, 60, 63, 65, 68, 71, 73, 76, 78, 81, 83, 85, 88,
+   90, 92, 94, 96, 98,100,102,104,106,107,109,111,112,113,115,116,
+  117,118,120,121,122,122,123,124,125,125,126,126,126,127,127,127,
+  127 };
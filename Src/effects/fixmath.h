@@ -0,0 +1,166 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Fixed point helpers for the effects. The x4 functions work on four bytes
+  packed in one word, like the XRGB pixel or four bytes of RGB framebuffer.
+  Cortex-M4 uses the SIMD instructions, other targets and the host use
+  the portable C code with the same results.
+
+  Licence: MIT License
+
+*/
+
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_DSP)
+#include "stm32f4xx.h"
+#endif
+
+// Quarter of the sine wave including the peak, sin8() mirrors it
+extern const uint8_t sinTable[65];
+
+// Saturating add, 200 + 100 = 255
+static inline uint8_t qadd8(uint8_t a, uint8_t b)
+{
+	uint32_t sum = a + b;
+
+	return sum > 255 ? 255 : sum;
+}
+
+// Saturating subtract, 100 - 200 = 0
+static inline uint8_t qsub8(uint8_t a, uint8_t b)
+{
+	return a > b ? a - b : 0;
+}
+
+// i * scale / 256, the scale 255 keeps the value
+static inline uint8_t scale8(uint8_t i, uint8_t scale)
+{
+	return (i * (scale + 1)) >> 8;
+}
+
+// From a to b, the fraction 0 is a and 256 is b
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint32_t fraction)
+{
+#if defined(__ARM_FEATURE_DSP)
+	// a * (256 - fraction) + b * fraction in one instruction
+	return __SMLAD((b << 16) | a, (fraction << 16) | (256 - fraction), 0) >> 8;
+#else
+	return (a * (256 - fraction) + b * fraction) >> 8;
+#endif
+}
+
+// Sine of the angle 0 - 255 as one period, the result is 1 - 255 with the centre in 128
+static inline uint8_t sin8(uint8_t theta)
+{
+	uint8_t index = theta & 0x3F;
+	uint8_t value;
+
+	if(theta & 0x40)
+		index = 64 - index;
+
+	value = sinTable[index];
+
+	return (theta & 0x80) ? 128 - value : 128 + value;
+}
+
+static inline uint8_t cos8(uint8_t theta)
+{
+	return sin8(theta + 64);
+}
+
+// Triangle wave of the angle 0 - 255 as one period, 0 - 254
+static inline uint8_t triangle8(uint8_t theta)
+{
+	return (theta & 0x80) ? (255 - theta) << 1 : theta << 1;
+}
+
+// Packed four bytes
+// ****************
+
+static inline uint32_t qadd8x4(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP)
+	return __UQADD8(a, b);
+#else
+	return (qadd8(a >> 24, b >> 24) << 24) | (qadd8(a >> 16, b >> 16) << 16) | (qadd8(a >> 8, b >> 8) << 8) | qadd8(a, b);
+#endif
+}
+
+static inline uint32_t qsub8x4(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP)
+	return __UQSUB8(a, b);
+#else
+	return (qsub8(a >> 24, b >> 24) << 24) | (qsub8(a >> 16, b >> 16) << 16) | (qsub8(a >> 8, b >> 8) << 8) | qsub8(a, b);
+#endif
+}
+
+// Even and odd bytes in two 16-bit lanes
+static inline uint32_t lanes8_even(uint32_t x)
+{
+#if defined(__ARM_FEATURE_DSP)
+	return __UXTB16(x);
+#else
+	return x & 0x00FF00FF;
+#endif
+}
+
+static inline uint32_t lanes8_odd(uint32_t x)
+{
+	return lanes8_even(x >> 8);
+}
+
+// All four bytes scaled, two multiplies for the whole word
+static inline uint32_t scale8x4(uint32_t x, uint8_t scale)
+{
+	uint32_t even = ((lanes8_even(x) * (scale + 1)) >> 8) & 0x00FF00FF;
+	uint32_t odd = (lanes8_odd(x) * (scale + 1)) & 0xFF00FF00;
+
+	return even | odd;
+}
+
+// Both 16-bit lanes multiplied by their own factor. The products fit in 16 bits,
+// so the lane of each multiply which belongs to the other factor is only dropped.
+static inline uint32_t mul16x2(uint32_t lanes, uint32_t factors)
+{
+	uint32_t low = lanes * (factors & 0xFFFF);
+	uint32_t high = lanes * (factors >> 16);
+
+#if defined(__ARM_FEATURE_DSP)
+	return __PKHBT(low, high, 0);
+#else
+	return (low & 0x0000FFFF) | (high & 0xFFFF0000);
+#endif
+}
+
+// Bytes multiplied each by its own byte, a * (b + 1) / 256 like scale8
+static inline uint32_t mul8x4(uint32_t a, uint32_t b)
+{
+	uint32_t even = (mul16x2(lanes8_even(a), lanes8_even(b) + 0x00010001) >> 8) & 0x00FF00FF;
+	uint32_t odd = mul16x2(lanes8_odd(a), lanes8_odd(b) + 0x00010001) & 0xFF00FF00;
+
+	return even | odd;
+}
+
+// Larger of each byte pair, a + (b - a) saturated
+static inline uint32_t max8x4(uint32_t a, uint32_t b)
+{
+	return qadd8x4(a, qsub8x4(b, a));
+}
+
+// All four bytes from a to b, the fraction 0 is a and 256 is b
+static inline uint32_t lerp8x4(uint32_t a, uint32_t b, uint32_t fraction)
+{
+	uint32_t inv = 256 - fraction;
+	uint32_t even = ((lanes8_even(a) * inv + lanes8_even(b) * fraction) >> 8) & 0x00FF00FF;
+	uint32_t odd = (lanes8_odd(a) * inv + lanes8_odd(b) * fraction) & 0xFF00FF00;
+
+	return even | odd;
+}
+
+#endif /* FIXMATH_H_ */
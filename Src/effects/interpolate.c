@@ -0,0 +1,81 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Output frames interpolated between the keyframes of a slow effect
+
+  Licence: MIT License
+
+*/
+
+#include <string.h>
+
+#include "effect.h"
+#include "fade.h"
+
+// The source renders only the keyframes into the state buffers
+static void interpolate_init(EffectInstance *instance)
+{
+	InterpolateState *state = instance->state;
+	EffectInstance *source = state->source;
+
+	// The render divides by the period, zero means a keyframe in every output frame
+	if(state->keyframePeriod == 0)
+		state->keyframePeriod = 1;
+
+	source->frameBuffer = state->next;
+	source->frameBufferSize = instance->frameBufferSize;
+	source->frameBufferCapacity = instance->frameBufferSize;
+	source->item = NULL;
+	source->layer = NULL;
+
+	if(source->effect->init)
+		source->effect->init(source);
+
+	// Both keyframes are the first one, the motion starts with the second
+	source->effect->render(source);
+	memcpy(state->previous, state->next, instance->frameBufferSize);
+	state->keyTime = timebase_us();
+}
+
+// Every output frame blends the last two keyframes, the output is one
+// keyframe period behind the source
+static uint8_t interpolate_render(EffectInstance *instance)
+{
+	InterpolateState *state = instance->state;
+	EffectInstance *source = state->source;
+	uint32_t elapsed = timebase_us() - state->keyTime;
+
+	if(elapsed >= state->keyframePeriod)
+	{
+		uint8_t *previous = state->previous;
+
+		state->previous = state->next;
+		state->next = previous;
+		state->keyTime += state->keyframePeriod;
+		elapsed -= state->keyframePeriod;
+
+		// Too late for more keyframes, start again from now
+		if(elapsed >= state->keyframePeriod)
+		{
+			state->keyTime += elapsed;
+			elapsed = 0;
+		}
+
+		// Accumulating sources like dots continue from the newest keyframe,
+		// the swapped buffer still holds the one from two periods ago
+		memcpy(state->next, state->previous, instance->frameBufferSize);
+		source->frameBuffer = state->next;
+		source->effect->render(source);
+	}
+
+	fade_crossfade(instance->frameBuffer, state->previous, state->next, instance->frameBufferSize, ((uint64_t)elapsed * 256) / state->keyframePeriod);
+
+	return 1;
+}
+
+const Effect effectInterpolate = {
+	.name = "interpolate",
+	.init = interpolate_init,
+	.render = interpolate_render
+};
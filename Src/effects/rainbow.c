@@ -0,0 +1,49 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Rainbow effect
+
+  Licence: MIT License
+
+*/
+
+#include "effect.h"
+
+// One rainbow, the item repeats it over the whole strip
+static uint32_t rainbow_period_size(EffectInstance *instance)
+{
+	RainbowState *state = instance->state;
+
+	return state->length * 4;
+}
+
+// Renders into XRGB framebuffer, every pixel is one word store. The pixel loop
+// walks the wheel table, there is no division.
+static uint8_t rainbow_render(EffectInstance *instance)
+{
+	RainbowState *state = instance->state;
+	uint32_t *frameBuffer = (uint32_t *)instance->frameBuffer;
+	uint32_t hue = state->phase;
+	uint32_t step = hue_step(state->length);
+	uint32_t i;
+
+	for( i = 0; i < instance->frameBufferSize / 4; i++)
+	{
+		frameBuffer[i] = hue_color(hue);
+		hue += step;
+	}
+
+	// Without the item there is no offset to scroll, like in the transition buffers,
+	// so the scroll moves the phase. The item scroll by one pixel shows the previous one.
+	if(instance->item == NULL)
+		state->phase -= instance->scroll * step;
+
+	return 1;
+}
+
+const Effect effectRainbow = {
+	.name = "rainbow",
+	.render = rainbow_render,
+	.periodSize = rainbow_period_size
+};
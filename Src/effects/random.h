@@ -0,0 +1,58 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Small xorshift random generator for the effects. Every effect instance
+  has its own state, the same seed gives the same frames.
+
+  Licence: MIT License
+
+*/
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+typedef struct Random {
+	uint32_t state;
+} Random;
+
+// Zero would stay zero forever, it is replaced by a constant
+static inline void random_seed(Random *random, uint32_t seed)
+{
+	random->state = seed ? seed : 0x9E3779B9;
+}
+
+// xorshift32, full period of 2^32 - 1
+static inline uint32_t random_next(Random *random)
+{
+	uint32_t x = random->state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	random->state = x;
+
+	return x;
+}
+
+// Number 0 to range - 1, multiply and shift instead of the modulo
+static inline uint32_t random_range(Random *random, uint32_t range)
+{
+	return ((uint64_t)random_next(random) * range) >> 32;
+}
+
+// 32 random bits, each one set with the probability 1 / 2^shift.
+// One call decides 32 pixels.
+static inline uint32_t random_mask(Random *random, uint32_t shift)
+{
+	uint32_t mask = 0xFFFFFFFF;
+
+	while(shift--)
+		mask &= random_next(random);
+
+	return mask;
+}
+
+#endif /* RANDOM_H_ */
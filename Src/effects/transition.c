@@ -0,0 +1,186 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Timed transitions between two effect instances
+
+  Licence: MIT License
+
+*/
+
+#include <string.h>
+
+#include "effect.h"
+#include "fade.h"
+
+// Word aligned, the crossfade blends four bytes at once
+static uint32_t effectPool[EFFECT_POOL_COUNT][EFFECT_POOL_SIZE / 4];
+static uint8_t effectPoolUsed[EFFECT_POOL_COUNT];
+
+// Free buffer of the pool cleared to zero, NULL when all are used or the size does not fit.
+// The accumulating sources like the dots start from the black and not from the last transition.
+uint8_t *effect_buffer_alloc(uint32_t size)
+{
+	uint32_t i;
+
+	if(size > EFFECT_POOL_SIZE)
+		return NULL;
+
+	for( i = 0; i < EFFECT_POOL_COUNT; i++ )
+	{
+		if(!effectPoolUsed[i])
+		{
+			effectPoolUsed[i] = 1;
+			memset(effectPool[i], 0, EFFECT_POOL_SIZE);
+			return (uint8_t *)effectPool[i];
+		}
+	}
+
+	return NULL;
+}
+
+void effect_buffer_free(uint8_t *buffer)
+{
+	uint32_t i;
+
+	for( i = 0; i < EFFECT_POOL_COUNT; i++ )
+	{
+		if(buffer == (uint8_t *)effectPool[i])
+			effectPoolUsed[i] = 0;
+	}
+}
+
+// Source renders into its pool buffer, not to any item
+static void transition_source(EffectInstance *source, uint8_t *buffer, uint32_t size)
+{
+	source->frameBuffer = buffer;
+	source->frameBufferSize = size;
+	source->frameBufferCapacity = size;
+	source->item = NULL;
+	source->layer = NULL;
+	source->cached = 0;
+}
+
+// Incoming source to the first pixels, outgoing one behind them
+static void transition_wipe(uint8_t *output, const uint8_t *from, const uint8_t *to, uint32_t size, uint32_t fraction, uint32_t pixelSize)
+{
+	uint32_t split = (((size / pixelSize) * fraction) >> 8) * pixelSize;
+
+	memcpy(output, to, split);
+	memcpy(output + split, from + split, size - split);
+}
+
+// The periodic cache shrank the item to one period and rotated its offset,
+// the transition and the incoming instance output the whole framebuffer
+static void transition_item_restore(EffectInstance *instance)
+{
+	if(instance->item == NULL)
+		return;
+
+	instance->item->frameBufferSize = instance->frameBufferCapacity;
+	instance->item->frameBufferOffset = 0;
+}
+
+// The incoming instance takes over the output, the pool buffers are returned
+static void transition_finish(EffectInstance *instance, TransitionState *state)
+{
+	EffectInstance *to = state->to;
+
+	effect_buffer_free(state->fromBuffer);
+	effect_buffer_free(state->toBuffer);
+	state->fromBuffer = NULL;
+	state->toBuffer = NULL;
+
+	transition_item_restore(instance);
+
+	to->frameBuffer = instance->frameBuffer;
+	to->frameBufferSize = instance->frameBufferCapacity;
+	to->frameBufferCapacity = instance->frameBufferCapacity;
+	to->item = instance->item;
+	to->layer = NULL;
+	to->cached = 0;
+
+	// The output holds the last frame of the incoming source, so the accumulating
+	// effects like the dots continue from it
+	state->done = 1;
+}
+
+static void transition_init(EffectInstance *instance)
+{
+	TransitionState *state = instance->state;
+
+	state->done = 0;
+	state->fromBuffer = NULL;
+	state->toBuffer = NULL;
+
+	// The outgoing instance on the same item knows the whole framebuffer size,
+	// the item may be shrunk to its cached period
+	if(instance->item && state->from->item == instance->item)
+	{
+		instance->frameBufferSize = state->from->frameBufferCapacity;
+		instance->frameBufferCapacity = instance->frameBufferSize;
+	}
+}
+
+static uint8_t transition_render(EffectInstance *instance)
+{
+	TransitionState *state = instance->state;
+	uint32_t size = instance->frameBufferSize;
+
+	if(state->done)
+		return effect_render(state->to);
+
+	// Start, the sources get their own buffers from the pool
+	if(state->fromBuffer == NULL)
+	{
+		transition_item_restore(instance);
+		state->fromBuffer = effect_buffer_alloc(size);
+		state->toBuffer = effect_buffer_alloc(size);
+		state->start = timebase_us();
+
+		// Not enough buffers, the transition is an instant cut
+		if(state->fromBuffer == NULL || state->toBuffer == NULL || state->duration == 0)
+		{
+			transition_finish(instance, state);
+
+			if(state->to->effect->init)
+				state->to->effect->init(state->to);
+
+			return effect_render(state->to);
+		}
+
+		// The outgoing source keeps its state and continues from the frame on the strip,
+		// so the fade starts from the current output
+		if(state->from->frameBuffer)
+			memcpy(state->fromBuffer, state->from->frameBuffer, state->from->frameBufferCapacity < size ? state->from->frameBufferCapacity : size);
+		transition_source(state->from, state->fromBuffer, size);
+
+		// The incoming one starts from the black pool buffer
+		transition_source(state->to, state->toBuffer, size);
+		if(state->to->effect->init)
+			state->to->effect->init(state->to);
+	}
+
+	uint32_t elapsed = timebase_us() - state->start;
+	uint32_t fraction = elapsed >= state->duration ? 256 : ((uint64_t)elapsed * 256) / state->duration;
+
+	// The sources have no item, the periodic ones render every frame and scroll by their phase
+	effect_render(state->from);
+	effect_render(state->to);
+
+	if(state->type == TRANSITION_WIPE)
+		transition_wipe(instance->frameBuffer, state->fromBuffer, state->toBuffer, size, fraction, state->pixelSize ? state->pixelSize : 3);
+	else
+		fade_crossfade(instance->frameBuffer, state->fromBuffer, state->toBuffer, size, fraction);
+
+	if(fraction == 256)
+		transition_finish(instance, state);
+
+	return 1;
+}
+
+const Effect effectTransition = {
+	.name = "transition",
+	.init = transition_init,
+	.render = transition_render
+};
@@ -0,0 +1,48 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Timed transitions between two effect instances
+
+  Licence: MIT License
+
+*/
+
+#ifndef TRANSITION_H_
+#define TRANSITION_H_
+
+#include <stdint.h>
+
+// Buffers shared by all the transitions, every running transition takes two
+#define EFFECT_POOL_COUNT 2
+// Bytes of one buffer, the longest output framebuffer in a transition
+#define EFFECT_POOL_SIZE (4*60)
+
+struct EffectInstance;
+
+typedef enum TransitionType {
+	TRANSITION_CROSSFADE = 0,	// both sources blended by the ramp
+	TRANSITION_WIPE				// the new source moves over the strip from its start
+} TransitionType;
+
+// The transition instance takes the place of the outgoing one. During the
+// transition both sources render into the pool buffers and the output is
+// their blend, then only the incoming one renders directly into the output.
+typedef struct TransitionState {
+	struct EffectInstance *from;
+	struct EffectInstance *to;
+	uint32_t duration;		// us
+	uint8_t type;			// TransitionType
+	uint8_t pixelSize;		// bytes of one LED for the wipe, 3 or 4
+
+	// Set by the transition
+	uint8_t done;
+	uint32_t start;
+	uint8_t *fromBuffer;
+	uint8_t *toBuffer;
+} TransitionState;
+
+uint8_t *effect_buffer_alloc(uint32_t size);
+void effect_buffer_free(uint8_t *buffer);
+
+#endif /* TRANSITION_H_ */
@@ -56,12 +56,36 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN 0 */
 
+// Sections of STM32F407VG_FLASH.ld which the startup code does not initialize
+extern uint32_t _siccmram, _sccmram, _eccmram;
+extern uint32_t _ssram2, _esram2;
+
+static void memory_section_copy(const uint32_t *load, uint32_t *start, const uint32_t *end)
+{
+	while(start < end)
+		*start++ = *load++;
+}
+
+static void memory_section_zero(uint32_t *start, const uint32_t *end)
+{
+	while(start < end)
+		*start++ = 0;
+}
+
+// CCM RAM framebuffers get their init values, SRAM2 bitbuffers are NOLOAD and only zeroed
+static void memory_sections_init(void)
+{
+	memory_section_copy(&_siccmram, &_sccmram, &_eccmram);
+	memory_section_zero(&_ssram2, &_esram2);
+}
+
 /* USER CODE END 0 */
 
 int main(void)
 {
 
   /* USER CODE BEGIN 1 */
+  memory_sections_init();
 
   /* USER CODE END 1 */
 
@@ -0,0 +1,157 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Memory to memory DMA for the framebuffer copy and fill
+
+  Licence: MIT License
+
+*/
+
+#include "memdma.h"
+
+#define CCMRAM_BASE_ADDRESS 0x10000000
+#define CCMRAM_END_ADDRESS 0x10010000
+
+static DMA_HandleTypeDef memdmaHandle;
+static void (*memdmaCallback)(HAL_StatusTypeDef status);
+
+// Fill is the copy from this word without the source increment
+static uint32_t memdmaFillValue;
+
+// Every transfer is reported exactly once, the callback is taken before it runs
+static void memdma_report(HAL_StatusTypeDef status)
+{
+	void (*callback)(HAL_StatusTypeDef status) = memdmaCallback;
+
+	memdmaCallback = NULL;
+
+	if(callback)
+		callback(status);
+}
+
+static void memdma_complete(DMA_HandleTypeDef *hdma)
+{
+	memdma_report(HAL_OK);
+}
+
+// Only the transfer error stops the stream, the HAL has disabled it then. The FIFO
+// and direct mode errors leave it running to the completion, which reports it.
+static void memdma_error(DMA_HandleTypeDef *hdma)
+{
+	if(hdma->ErrorCode & HAL_DMA_ERROR_TE)
+		memdma_report(HAL_ERROR);
+}
+
+HAL_StatusTypeDef memdma_init(void)
+{
+	DMA_HandleTypeDef *hdma = &memdmaHandle;
+
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	// Memory to memory works only with the FIFO, single beats keep the bus
+	// free for the engine streams between every word
+	hdma->Instance = MEMDMA_STREAM;
+	hdma->Init.Channel = DMA_CHANNEL_0;
+	hdma->Init.Direction = DMA_MEMORY_TO_MEMORY;
+	hdma->Init.PeriphInc = DMA_PINC_ENABLE;
+	hdma->Init.MemInc = DMA_MINC_ENABLE;
+	hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+	hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+	hdma->Init.Mode = DMA_NORMAL;
+	hdma->Init.Priority = DMA_PRIORITY_LOW;
+	hdma->Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+	hdma->Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+	hdma->Init.MemBurst = DMA_MBURST_SINGLE;
+	hdma->Init.PeriphBurst = DMA_PBURST_SINGLE;
+
+	hdma->XferCpltCallback = memdma_complete;
+	hdma->XferErrorCallback = memdma_error;
+
+	HAL_DMA_DeInit(hdma);
+
+	if(HAL_DMA_Init(hdma) != HAL_OK)
+		return HAL_ERROR;
+
+	// Below the engine IRQs
+	HAL_NVIC_SetPriority(MEMDMA_IRQ, 2, 0);
+	HAL_NVIC_EnableIRQ(MEMDMA_IRQ);
+
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef memdma_start(void *destination, const void *source, uint32_t size, uint32_t sourceInc, void (*callback)(HAL_StatusTypeDef status))
+{
+	DMA_HandleTypeDef *hdma = &memdmaHandle;
+	uint32_t address = (uint32_t)destination;
+	uint32_t width, count;
+
+	if(hdma->State != HAL_DMA_STATE_READY)
+		return HAL_BUSY;
+
+	if(address >= CCMRAM_BASE_ADDRESS && address < CCMRAM_END_ADDRESS)
+		return HAL_ERROR;
+
+	address = (uint32_t)source;
+	if(address >= CCMRAM_BASE_ADDRESS && address < CCMRAM_END_ADDRESS)
+		return HAL_ERROR;
+
+	if((((uint32_t)destination | (uint32_t)source | size) & 0x03) == 0)
+	{
+		width = DMA_PDATAALIGN_WORD | DMA_MDATAALIGN_WORD;
+		count = size / 4;
+	} else {
+		width = DMA_PDATAALIGN_BYTE | DMA_MDATAALIGN_BYTE;
+		count = size;
+	}
+
+	if(count > 0xFFFF)
+		return HAL_ERROR;
+
+	if(count == 0)
+	{
+		if(callback)
+			callback(HAL_OK);
+		return HAL_OK;
+	}
+
+	// The stream is disabled now, the widths and the source increment can change
+	hdma->Instance->CR &= ~(DMA_SxCR_PSIZE | DMA_SxCR_MSIZE | DMA_SxCR_PINC);
+	hdma->Instance->CR |= width | sourceInc;
+
+	memdmaCallback = callback;
+
+	return HAL_DMA_Start_IT(hdma, (uint32_t)source, (uint32_t)destination, count);
+}
+
+HAL_StatusTypeDef memdma_copy(void *destination, const void *source, uint32_t size, void (*callback)(HAL_StatusTypeDef status))
+{
+	return memdma_start(destination, source, size, DMA_PINC_ENABLE, callback);
+}
+
+// Every byte of the value is the same with the byte transfers, use colours like 0x00000000 or 0xFFFFFFFF there
+HAL_StatusTypeDef memdma_fill(void *destination, uint32_t value, uint32_t size, void (*callback)(HAL_StatusTypeDef status))
+{
+	if(memdma_busy())
+		return HAL_BUSY;
+
+	memdmaFillValue = value;
+
+	return memdma_start(destination, &memdmaFillValue, size, DMA_PINC_DISABLE, callback);
+}
+
+uint8_t memdma_busy(void)
+{
+	return memdmaHandle.State != HAL_DMA_STATE_READY;
+}
+
+void memdma_wait(void)
+{
+	while(memdma_busy())
+		;
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&memdmaHandle);
+}
@@ -0,0 +1,35 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Memory to memory DMA for the framebuffer copy and fill
+
+  Licence: MIT License
+
+*/
+
+#ifndef MEMDMA_H_
+#define MEMDMA_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+// DMA2 Stream 0 is not used by any engine. The stream has the low priority,
+// so the engine streams with the very high one always win the DMA arbitration
+// and the LED timing is kept. The DMA has no access to the CCM RAM.
+#define MEMDMA_STREAM DMA2_Stream0
+#define MEMDMA_IRQ DMA2_Stream0_IRQn
+
+HAL_StatusTypeDef memdma_init(void);
+
+// Start the transfer and return, the callback is called from the DMA IRQ when
+// it is done with HAL_OK, or with HAL_ERROR after the bus error. Aligned buffers with the size divisible by 4 are moved by words,
+// the others by bytes. Up to 65535 words or bytes, HAL_BUSY during a transfer.
+HAL_StatusTypeDef memdma_copy(void *destination, const void *source, uint32_t size, void (*callback)(HAL_StatusTypeDef status));
+HAL_StatusTypeDef memdma_fill(void *destination, uint32_t value, uint32_t size, void (*callback)(HAL_StatusTypeDef status));
+
+uint8_t memdma_busy(void);
+void memdma_wait(void);
+
+#endif /* MEMDMA_H_ */
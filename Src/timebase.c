@@ -0,0 +1,86 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Microsecond timebase on the free running TIM2 and the frame pacing
+
+  Licence: MIT License
+
+*/
+
+#include <string.h>
+
+#include "timebase.h"
+
+static TIM_HandleTypeDef timebaseHandle;
+
+HAL_StatusTypeDef timebase_init(void)
+{
+	// TIM2 on APB1 runs twice the APB1 clock when APB1 is divided
+	uint32_t clock = HAL_RCC_GetPCLK1Freq();
+
+	if((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+		clock *= 2;
+
+	__HAL_RCC_TIM2_CLK_ENABLE();
+
+	timebaseHandle.Instance = TIM2;
+	timebaseHandle.Init.Prescaler = clock / 1000000 - 1;
+	timebaseHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+	timebaseHandle.Init.Period = 0xFFFFFFFF;
+	timebaseHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	timebaseHandle.Init.RepetitionCounter = 0;
+
+	if(HAL_TIM_Base_Init(&timebaseHandle) != HAL_OK)
+		return HAL_ERROR;
+
+	return HAL_TIM_Base_Start(&timebaseHandle);
+}
+
+void pacer_stats_reset(FramePacer *pacer)
+{
+	memset(&pacer->jitter, 0, sizeof(pacer->jitter));
+	pacer->jitter.min = 0xFFFFFFFF;
+}
+
+// The frame time divides the lateness, zero is taken as 1 us, every call is due
+void pacer_init(FramePacer *pacer, uint32_t frameTime)
+{
+	pacer->frameTime = frameTime ? frameTime : 1;
+	pacer->previous = timebase_us();
+	pacer->next = pacer->previous;
+	pacer->delta = 0;
+	pacer->steps = 0;
+	pacer_stats_reset(pacer);
+}
+
+// Call it when the transfer is complete, returns 1 when the next frame should
+// be rendered. The frame times do not drift, the next one is planned from the
+// planned time of this one, not from the moment it really started.
+uint8_t pacer_due(FramePacer *pacer)
+{
+	uint32_t now = timebase_us();
+	uint32_t late = now - pacer->next;
+
+	// Not yet, the difference is negative
+	if(late & 0x80000000)
+		return 0;
+
+	pacer->delta = now - pacer->previous;
+	pacer->previous = now;
+	pacer->steps = 1 + late / pacer->frameTime;
+
+	// Skip the missed frames instead of rendering them in a burst
+	pacer->next += pacer->steps * pacer->frameTime;
+
+	WS2812_Stats *jitter = &pacer->jitter;
+	jitter->last = late;
+	if(late < jitter->min)
+		jitter->min = late;
+	if(late > jitter->max)
+		jitter->max = late;
+	jitter->count++;
+	jitter->total += late;
+
+	return 1;
+}
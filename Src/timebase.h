@@ -0,0 +1,41 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Microsecond timebase on the free running TIM2 and the frame pacing
+
+  Licence: MIT License
+
+*/
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+#include "ws2812b/ws2812b.h"
+
+// Frames at the fixed rate, started only when the transfer is complete
+typedef struct FramePacer {
+	uint32_t frameTime;		// us between the frames
+	uint32_t next;			// timebase of the next frame
+	uint32_t previous;		// timebase of the previous frame
+	uint32_t delta;			// real us since the previous frame
+	uint32_t steps;			// fixed frame times since the previous frame, more than 1 after a late frame
+	WS2812_Stats jitter;	// us the frames started after their time
+} FramePacer;
+
+// TIM2 is 32-bit and counts the microseconds, it wraps after 71 minutes
+static inline uint32_t timebase_us(void)
+{
+	return TIM2->CNT;
+}
+
+HAL_StatusTypeDef timebase_init(void);
+
+void pacer_init(FramePacer *pacer, uint32_t frameTime);
+uint8_t pacer_due(FramePacer *pacer);
+void pacer_stats_reset(FramePacer *pacer);
+
+#endif /* TIMEBASE_H_ */
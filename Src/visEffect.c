@@ -16,103 +16,39 @@
 
 #include "stm32f4xx_hal.h"
 #include "ws2812b/ws2812b.h"
-#include <stdlib.h>
-
-// RGB Framebuffers
-uint8_t frameBuffer[3*60];
-uint8_t frameBuffer2[3*20];
-
-// Helper defines
-#define newColor(r, g, b) (((uint32_t)(r) << 16) | ((uint32_t)(g) <<  8) | (b))
-#define Red(c) ((uint8_t)((c >> 16) & 0xFF))
-#define Green(c) ((uint8_t)((c >> 8) & 0xFF))
-#define Blue(c) ((uint8_t)(c & 0xFF))
-
-
-uint32_t Wheel(uint8_t WheelPos) {
-  WheelPos = 255 - WheelPos;
-  if(WheelPos < 85) {
-    return newColor(255 - WheelPos * 3, 0, WheelPos * 3);
-  }
-  if(WheelPos < 170) {
-    WheelPos -= 85;
-    return newColor(0, WheelPos * 3, 255 - WheelPos * 3);
-  }
-  WheelPos -= 170;
-  return newColor(WheelPos * 3, 255 - WheelPos * 3, 0);
-}
-
-
-
-
-void visRainbow(uint8_t *frameBuffer, uint32_t frameBufferSize, uint32_t effectLength)
-{
-	uint32_t i;
-	static uint8_t x = 0;
-
-	x += 1;
-
-	if(x == 256*5)
-		x = 0;
-
-	for( i = 0; i < frameBufferSize / 3; i++)
-	{
-		uint32_t color = Wheel(((i * 256) / effectLength + x) & 0xFF);
-
-		frameBuffer[i*3 + 0] = color & 0xFF;
-		frameBuffer[i*3 + 1] = color >> 8 & 0xFF;
-		frameBuffer[i*3 + 2] = color >> 16 & 0xFF;
-	}
-}
-
-
-void visDots(uint8_t *frameBuffer, uint32_t frameBufferSize, uint32_t random, uint32_t fadeOutFactor)
-{
-	uint32_t i;
-
-	for( i = 0; i < frameBufferSize / 3; i++)
-	{
-
-		if(rand() % random == 0)
-		{
-			frameBuffer[i*3 + 0] = 255;
-			frameBuffer[i*3 + 1] = 255;
-			frameBuffer[i*3 + 2] = 255;
-		}
-
-
-		if(frameBuffer[i*3 + 0] > fadeOutFactor)
-			frameBuffer[i*3 + 0] -= frameBuffer[i*3 + 0]/fadeOutFactor;
-		else
-			frameBuffer[i*3 + 0] = 0;
-
-		if(frameBuffer[i*3 + 1] > fadeOutFactor)
-			frameBuffer[i*3 + 1] -= frameBuffer[i*3 + 1]/fadeOutFactor;
-		else
-			frameBuffer[i*3 + 1] = 0;
-
-		if(frameBuffer[i*3 + 2] > fadeOutFactor)
-			frameBuffer[i*3 + 2] -= frameBuffer[i*3 + 2]/fadeOutFactor;
-		else
-			frameBuffer[i*3 + 2] = 0;
-	}
-}
-
-
-// Animate effects
-void visHandle2()
-{
-	static uint32_t timestamp;
-
-	if(HAL_GetTick() - timestamp > 10)
-	{
-		timestamp = HAL_GetTick();
-
-		// Animate next frame, each effect into each output RGB framebuffer
-		visRainbow(frameBuffer, sizeof(frameBuffer), 15);
-		visDots(frameBuffer2, sizeof(frameBuffer2), 50, 40);
-	}
-}
+#include "effects/effect.h"
+#include "timebase.h"
+
+// Framebuffers, the first one with 32-bit XRGB words. Only the CPU reads them,
+// so they are in the CCM RAM and leave the SRAM buses to the DMA.
+uint32_t frameBuffer[60] WS2812B_CCMRAM;
+uint8_t frameBuffer2[3*20] WS2812B_CCMRAM;
+
+// Effects of the default engine, every even output scrolls the rainbow
+// and every odd one shows the dots
+static RainbowState rainbow[(WS2812_BUFFER_COUNT + 1) / 2];
+static DotsState dots = { .density = 6, .fade = 249, .seed = 1 };
+static EffectInstance effects[(WS2812_BUFFER_COUNT + 1) / 2 + 1];
+static uint32_t effectCount;
+// Frame rate of the engine, see pacer.jitter in the debugger
+static FramePacer pacer;
+
+#if defined(WS2812B_USE_TIM8)
+// Second engine on TIM8 with its own strip length and frame rate
+WS2812_Struct ws2812b2;
+uint8_t frameBuffer3[3*120] WS2812B_CCMRAM;
+// Palette indexed rainbow, 1 byte per LED, animated only by the palette rotation
+uint8_t frameBuffer4[120] WS2812B_CCMRAM;
+uint32_t palette[256] WS2812B_CCMRAM;
+
+static DotsState dots2 = { .density = 7, .fade = 242, .seed = 2 };
+static CycleState cycle = { .step = 1 };
+static FramePacer pacer2;
+static EffectInstance effects2[] = {
+	{ .effect = &effectDots, .state = &dots2, .item = &ws2812b2.item[0], .period = 20000 },
+	{ .effect = &effectCycle, .state = &cycle, .item = &ws2812b2.item[2], .period = 20000 },
+};
+#endif
 
 
 void visInit()
@@ -120,9 +56,13 @@ void visInit()
 
 	uint8_t i;
 
+	// Microsecond timebase for the effects and the frame pacing
+	timebase_init();
+	pacer_init(&pacer, 10000);
+
 	// HELP
 	// Fill the 8 structures to simulate overhead of 8 paralel strips
-	// The pins are not enabled in the WS2812B init. There are enabled only PC0-3
+	// The output pins are derived from the item channels, here PC0-3
 	// The 16 channels are possible at 168MHz with 60% IRQ overhead during data TX
 
 	// 4 paralel output LED strips needs 18% overhead during TX
@@ -132,16 +72,28 @@ void visInit()
 	for( i = 0; i < WS2812_BUFFER_COUNT; i++)
 	{
 
-		// Set output channel/pin, GPIO_PIN_0 = 0, for GPIO_PIN_5 = 5 - this has to correspond to WS2812B_PINS
+		// Set output channel/pin, GPIO_PIN_0 = 0, for GPIO_PIN_5 = 5
 		ws2812b.item[i].channel = i;
 
 		// Every even output line has second frameBuffer2 with different effect
 		if(i % 2 == 0)
 		{
-			// Your RGB framebuffer
-			ws2812b.item[i].frameBufferPointer = frameBuffer;
+			// Your framebuffer, here with 32-bit XRGB pixels
+			ws2812b.item[i].frameBufferPointer = (uint8_t*)frameBuffer;
 			// RAW size of framebuffer
 			ws2812b.item[i].frameBufferSize = sizeof(frameBuffer);
+			ws2812b.item[i].format = WS2812B_FORMAT_XRGB;
+
+			// Rainbow period is rendered only once and then just scrolled by the item offset.
+			// One LED of the 15 LED period every 170 ms is the full turn in 2.56 s,
+			// the speed of the original 1/256 turn per 10 ms frame.
+			rainbow[i / 2].length = 15;
+			effects[effectCount].effect = &effectRainbow;
+			effects[effectCount].state = &rainbow[i / 2];
+			effects[effectCount].item = &ws2812b.item[i];
+			effects[effectCount].period = 170000;
+			effects[effectCount].scroll = 1;
+			effectCount++;
 		} else {
 			ws2812b.item[i].frameBufferPointer = frameBuffer2;
 			ws2812b.item[i].frameBufferSize = sizeof(frameBuffer2);
@@ -149,23 +101,74 @@ void visInit()
 
 	}
 
+	// The odd outputs share one framebuffer, so the dots are rendered once
+	effects[effectCount].effect = &effectDots;
+	effects[effectCount].state = &dots;
+	effects[effectCount].item = &ws2812b.item[1];
+	effects[effectCount].period = 10000;
+	effectCount++;
 
 	ws2812b_init();
+	effect_init(effects, effectCount);
+
+#if defined(WS2812B_USE_TIM8)
+	// Second engine has its own timer, DMA streams and GPIO port
+	ws2812b2.timer = WS2812B_TIM8;
+	ws2812b2.port = GPIOE;
+	ws2812b2.numberOfLeds = 120;
+	ws2812b2.itemCount = 3;
+
+	for( i = 0; i < 2; i++)
+	{
+		// GPIO_PIN_8 = 8, GPIO_PIN_9 = 9
+		ws2812b2.item[i].channel = 8 + i;
+		ws2812b2.item[i].frameBufferPointer = frameBuffer3;
+		ws2812b2.item[i].frameBufferSize = sizeof(frameBuffer3);
+	}
+
+	// Second strip shows only the first 20 pixels blended over all 120 LEDs
+	ws2812b2.item[1].frameBufferSize = 3*20;
+	ws2812b2.item[1].readMode = WS2812B_READ_STRETCH_LINEAR;
+
+	// Third strip on PE10 with the palette, the colours are encoded only once here
+	for( i = 0; i < sizeof(frameBuffer4); i++)
+		frameBuffer4[i] = (i * 256) / sizeof(frameBuffer4);
+
+	uint32_t j;
+	for( j = 0; j < 256; j++)
+		palette[j] = ws2812b_encode_color(Wheel(j));
+
+	ws2812b2.item[2].channel = 10;
+	ws2812b2.item[2].frameBufferPointer = frameBuffer4;
+	ws2812b2.item[2].frameBufferSize = sizeof(frameBuffer4);
+	ws2812b2.item[2].format = WS2812B_FORMAT_PAL8;
+	ws2812b2.item[2].palette = palette;
+
+	ws2812b_engine_init(&ws2812b2);
+	effect_init(effects2, sizeof(effects2) / sizeof(effects2[0]));
+	pacer_init(&pacer2, 20000);
+#endif
 }
 
 
 void visHandle()
 {
 
-	if(ws2812b.transferComplete)
+	// Update your framebuffer here or swap buffers. The frames are paced by
+	// the timebase and the transfer is started only when some effect changed its output
+	if(ws2812b.transferComplete && pacer_due(&pacer) && effect_handle(effects, effectCount))
 	{
-		// Update your framebuffer here or swap buffers
-		visHandle2();
-
 		// Signal that buffer is changed and transfer new data
 		ws2812b.startTransfer = 1;
 		ws2812b_handle();
 	}
-}
-
 
+#if defined(WS2812B_USE_TIM8)
+	// Engines are independent, each one is refreshed when it is done
+	if(ws2812b2.transferComplete && pacer_due(&pacer2) && effect_handle(effects2, sizeof(effects2) / sizeof(effects2[0])))
+	{
+		ws2812b2.startTransfer = 1;
+		ws2812b_engine_handle(&ws2812b2);
+	}
+#endif
+}
@@ -17,17 +17,11 @@
 #include "stm32f4xx_hal.h"
 #include "ws2812b.h"
 
-extern WS2812_Struct ws2812b;
-
-// Define source arrays for my DMAs
-uint32_t WS2812_IO_High[] =  { WS2812B_PINS };
-uint32_t WS2812_IO_Low[] = {WS2812B_PINS << 16};
-
-// WS2812 framebuffer - buffer for 2 LEDs - two times 24 bits
-uint16_t ws2812bDmaBitBuffer[24 * 2];
+// Default engine
+WS2812_Struct ws2812b;
 
 // Gamma correction table
-const uint8_t gammaTable[] = {
+const uint8_t gammaTable[] WS2812B_RAMDATA = {
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
     1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
@@ -45,16 +39,135 @@ const uint8_t gammaTable[] = {
   177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
   215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255 };
 
-static void ws2812b_gpio_init(void)
+// Bitbuffer encoder of the target, bit-banding exists only on Cortex-M3 and M4
+#if !defined(SETPIX_1) && !defined(SETPIX_2) && !defined(SETPIX_3) && !defined(SETPIX_4) && !defined(SETPIX_5) && !defined(SETPIX_TRANSPOSE)
+#if (__CORTEX_M == 3) || (__CORTEX_M == 4)
+#define SETPIX_4
+#else
+#define SETPIX_TRANSPOSE
+#endif
+#endif
+
+// RBIT and PKHBT/PKHTB of the Cortex-M4/M7 DSP extension
+#if defined(SETPIX_5) && !defined(__ARM_FEATURE_DSP)
+#error "SETPIX_5 needs a core with the DSP instructions"
+#endif
+
+// The bit-band alias covers only the first 1 MB of SRAM, other bitbuffers use the transpose
+#if defined(SETPIX_2) || defined(SETPIX_4)
+#define SETPIX_BITBAND
+#define BITBAND_REACHABLE(address) (((uint32_t)(address) - RAM_BASE) < 0x100000)
+#endif
+
+// Index of the DMA slots in the WS2812_TimerHw
+#define SLOT_HIGH	0
+#define SLOT_DATA	1
+#define SLOT_LOW	2
+
+// Slot is triggered by the timer update, not by compare channel
+#define NO_CHANNEL	0xFFFFFFFF
+
+// Stream with the half and complete transfer IRQ
+#if defined(WS2812B_TWO_STREAMS)
+#define SLOT_IRQ	SLOT_DATA
+#else
+#define SLOT_IRQ	SLOT_LOW
+#endif
+
+// Half of the bitbuffer has unknown content, the patterns have the low byte cleared
+#define NO_PATTERN	0x000000FF
+
+// Timer and DMA2 resources of one engine. TIM1 and TIM8 requests are on
+// different DMA2 streams so both engines can transmit at the same time.
+typedef struct WS2812_TimerHw {
+	TIM_TypeDef *instance;
+	uint32_t apb2ClockEnable;
+	IRQn_Type updateIrq;
+	DMA_Stream_TypeDef *stream[3];	// NULL when the slot shares the data stream
+	uint32_t dmaChannel[3];
+	uint32_t dmaRequest[3];
+	uint32_t timChannel[3];
+	IRQn_Type dmaIrq;	// IRQ of the SLOT_IRQ stream
+} WS2812_TimerHw;
+
+#if defined(WS2812B_TWO_STREAMS)
+// The combined CH1/CH2/CH3 request runs one stream for both compare channels,
+// it writes the 32-bit BSRR words: set all outputs on CC1 and reset the zero
+// bits on CC2. Update at the bit end resets all outputs from a constant word.
+static const WS2812_TimerHw timerHw[WS2812B_TIMER_COUNT] = {
+	{
+		TIM1, RCC_APB2ENR_TIM1EN, TIM1_UP_TIM10_IRQn,
+		{ NULL, DMA2_Stream6, DMA2_Stream5 },
+		{ DMA_CHANNEL_0, DMA_CHANNEL_0, DMA_CHANNEL_6 },
+		{ TIM_DMA_CC1, TIM_DMA_CC2, TIM_DMA_UPDATE },
+		{ TIM_CHANNEL_1, TIM_CHANNEL_2, NO_CHANNEL },
+		DMA2_Stream6_IRQn
+	},
+	{
+		TIM8, RCC_APB2ENR_TIM8EN, TIM8_UP_TIM13_IRQn,
+		{ NULL, DMA2_Stream2, DMA2_Stream1 },
+		{ DMA_CHANNEL_0, DMA_CHANNEL_0, DMA_CHANNEL_7 },
+		{ TIM_DMA_CC1, TIM_DMA_CC2, TIM_DMA_UPDATE },
+		{ TIM_CHANNEL_1, TIM_CHANNEL_2, NO_CHANNEL },
+		DMA2_Stream2_IRQn
+	}
+};
+#else
+// TIM8_UP shares Stream 1 with TIM1_CH1, so TIM8 generates its high pulse
+// with compare channel CC2 at the counter value 0 instead.
+static const WS2812_TimerHw timerHw[WS2812B_TIMER_COUNT] = {
+	{
+		TIM1, RCC_APB2ENR_TIM1EN, TIM1_UP_TIM10_IRQn,
+		{ DMA2_Stream5, DMA2_Stream1, DMA2_Stream2 },
+		{ DMA_CHANNEL_6, DMA_CHANNEL_6, DMA_CHANNEL_6 },
+		{ TIM_DMA_UPDATE, TIM_DMA_CC1, TIM_DMA_CC2 },
+		{ NO_CHANNEL, TIM_CHANNEL_1, TIM_CHANNEL_2 },
+		DMA2_Stream2_IRQn
+	},
+	{
+		TIM8, RCC_APB2ENR_TIM8EN, TIM8_UP_TIM13_IRQn,
+		{ DMA2_Stream3, DMA2_Stream4, DMA2_Stream7 },
+		{ DMA_CHANNEL_7, DMA_CHANNEL_7, DMA_CHANNEL_7 },
+		{ TIM_DMA_CC2, TIM_DMA_CC3, TIM_DMA_CC4 },
+		{ TIM_CHANNEL_2, TIM_CHANNEL_3, TIM_CHANNEL_4 },
+		DMA2_Stream7_IRQn
+	}
+};
+#endif
+
+// Engines which are running on each timer, used by the IRQ handlers
+static WS2812_Struct *engineOwner[WS2812B_TIMER_COUNT];
+
+// DMA sources of the engine on each timer. With WS2812B_SRAM2_BITBUFFER they are
+// alone in SRAM2, the CPU accesses to SRAM1 do not stall the DMA reads.
+typedef struct WS2812_DmaSource {
+	uint32_t ioHigh;
+	uint32_t ioLow;
+	uint16_t bitBuffer[WS2812B_BITBUFFER_SIZE];
+#if defined(WS2812B_TWO_STREAMS)
+	uint32_t bsrrWords[2 * WS2812B_BITBUFFER_SIZE];	// set and data reset word of every bit
+#endif
+} WS2812_DmaSource;
+
+static WS2812_DmaSource dmaSource[WS2812B_TIMER_COUNT] WS2812B_SRAM2;
+
+#if !defined(SETPIX_TRANSPOSE)
+static void ws2812b_set_pixel(uint16_t *bitBuffer, uint8_t row, uint16_t column, uint32_t pattern);
+#endif
+
+static void ws2812b_gpio_init(WS2812_Struct *engine)
 {
-	// WS2812B outputs
-	WS2812B_GPIO_CLK_ENABLE();
+	// WS2812B outputs, GPIO ports are 0x400 apart as their clock enable bits are
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN << (((uint32_t)engine->port - GPIOA_BASE) / 0x400);
+	// Delay after an RCC peripheral clock enabling
+	(void)RCC->AHB1ENR;
+
 	GPIO_InitTypeDef  GPIO_InitStruct;
-	GPIO_InitStruct.Pin       = WS2812B_PINS;
+	GPIO_InitStruct.Pin       = engine->pins;
 	GPIO_InitStruct.Mode      = GPIO_MODE_OUTPUT_PP;
 	GPIO_InitStruct.Pull      = GPIO_NOPULL;
 	GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_LOW;
-	HAL_GPIO_Init(WS2812B_PORT, &GPIO_InitStruct);
+	HAL_GPIO_Init(engine->port, &GPIO_InitStruct);
 
 	// Enable output pins for debuging to see DMA Full and Half transfer interrupts
 	#if defined(LED_BLUE_PORT) && defined(LED_ORANGE_PORT)
@@ -71,228 +184,698 @@ static void ws2812b_gpio_init(void)
 	#endif
 }
 
-TIM_HandleTypeDef    TIM1_handle;
-TIM_OC_InitTypeDef tim2OC1;
-TIM_OC_InitTypeDef tim2OC2;
-
-uint32_t tim_period;
-uint32_t timer_reset_pulse_period;
+static HAL_StatusTypeDef ws2812b_tim_channel_init(WS2812_Struct *engine, uint32_t channel, uint32_t pulse)
+{
+	TIM_OC_InitTypeDef timOC;
+
+	timOC.OCMode       = TIM_OCMODE_PWM1;
+	timOC.OCPolarity   = TIM_OCPOLARITY_HIGH;
+	timOC.Pulse        = pulse;
+	timOC.OCNPolarity  = TIM_OCNPOLARITY_HIGH;
+	timOC.OCFastMode   = TIM_OCFAST_DISABLE;
+	timOC.OCIdleState  = TIM_OCIDLESTATE_RESET;
+	timOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+	return HAL_TIM_PWM_ConfigChannel(&engine->timHandle, &timOC, channel);
+}
 
-static void TIM1_init(void)
+static HAL_StatusTypeDef ws2812b_tim_init(WS2812_Struct *engine)
 {
-	// TIM2 Periph clock enable
-	__HAL_RCC_TIM1_CLK_ENABLE();
+	const WS2812_TimerHw *hw = &timerHw[engine->timer];
+
+	// Timer periph clock enable, both TIM1 and TIM8 are on APB2
+	RCC->APB2ENR |= hw->apb2ClockEnable;
+	(void)RCC->APB2ENR;
 
 	// This computation of pulse length should work ok,
 	// at some slower core speeds it needs some tuning.
-	tim_period =  SystemCoreClock / 800000; // 0,125us period (10 times lower the 1,25us period to have fixed math below)
-	timer_reset_pulse_period = (SystemCoreClock / (320 * 60)); // 60us just to be sure
-
-	uint32_t cc1 = (10 * tim_period) / 36;
-	uint32_t cc2 = (10 * tim_period) / 15;
+	engine->timPeriod =  SystemCoreClock / 800000; // 0,125us period (10 times lower the 1,25us period to have fixed math below)
+	engine->timResetPeriod = (SystemCoreClock / (320 * 60)); // 60us just to be sure
+
+	uint32_t cc1 = (10 * engine->timPeriod) / 36;
+	uint32_t cc2 = (10 * engine->timPeriod) / 15;
+
+#if defined(WS2812B_TWO_STREAMS)
+	// The bit is shifted so its high time ends on the counter overflow and the Update resets the outputs
+	uint32_t start = engine->timPeriod - cc2;
+	engine->timStart = start - 1;
+#else
+	uint32_t start = 0;
+	engine->timStart = engine->timPeriod - 1;
+#endif
 
-	TIM1_handle.Instance = TIM1;
+	engine->timHandle.Instance = hw->instance;
 
-	TIM1_handle.Init.Period            = tim_period;
-	TIM1_handle.Init.RepetitionCounter = 0;
-	TIM1_handle.Init.Prescaler         = 0;
-	TIM1_handle.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
-	TIM1_handle.Init.CounterMode       = TIM_COUNTERMODE_UP;
-	HAL_TIM_PWM_Init(&TIM1_handle);
+	engine->timHandle.Init.Period            = engine->timPeriod;
+	engine->timHandle.Init.RepetitionCounter = 0;
+	engine->timHandle.Init.Prescaler         = 0;
+	engine->timHandle.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
+	engine->timHandle.Init.CounterMode       = TIM_COUNTERMODE_UP;
+	if(HAL_TIM_PWM_Init(&engine->timHandle) != HAL_OK)
+		return HAL_ERROR;
 
-	HAL_NVIC_SetPriority(TIM1_UP_TIM10_IRQn, 0, 0);
-	HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+	HAL_NVIC_SetPriority(hw->updateIrq, 0, 0);
+	HAL_NVIC_EnableIRQ(hw->updateIrq);
 
-	tim2OC1.OCMode       = TIM_OCMODE_PWM1;
-	tim2OC1.OCPolarity   = TIM_OCPOLARITY_HIGH;
-	tim2OC1.Pulse        = cc1;
-	tim2OC1.OCNPolarity  = TIM_OCNPOLARITY_HIGH;
-	tim2OC1.OCFastMode   = TIM_OCFAST_DISABLE;
-	HAL_TIM_PWM_ConfigChannel(&TIM1_handle, &tim2OC1, TIM_CHANNEL_1);
+	// High slot on compare channel fires at the bit start, right after the counter overflow in the three stream mode
+	if(hw->timChannel[SLOT_HIGH] != NO_CHANNEL)
+		ws2812b_tim_channel_init(engine, hw->timChannel[SLOT_HIGH], start);
 
-	tim2OC2.OCMode       = TIM_OCMODE_PWM1;
-	tim2OC2.OCPolarity   = TIM_OCPOLARITY_HIGH;
-	tim2OC2.Pulse        = cc2;
-	tim2OC2.OCNPolarity  = TIM_OCNPOLARITY_HIGH;
-	tim2OC2.OCFastMode   = TIM_OCFAST_DISABLE;
-	tim2OC2.OCIdleState  = TIM_OCIDLESTATE_RESET;
-	tim2OC2.OCNIdleState = TIM_OCNIDLESTATE_RESET;
-	HAL_TIM_PWM_ConfigChannel(&TIM1_handle, &tim2OC2, TIM_CHANNEL_2);
+	ws2812b_tim_channel_init(engine, hw->timChannel[SLOT_DATA], start + cc1);
 
+	if(hw->timChannel[SLOT_LOW] != NO_CHANNEL)
+		ws2812b_tim_channel_init(engine, hw->timChannel[SLOT_LOW], start + cc2);
 
-	HAL_TIM_Base_Start(&TIM1_handle);
-	HAL_TIM_PWM_Start(&TIM1_handle, TIM_CHANNEL_1);
+	HAL_TIM_Base_Start(&engine->timHandle);
+	HAL_TIM_PWM_Start(&engine->timHandle, hw->timChannel[SLOT_DATA]);
 
-	__HAL_TIM_DISABLE(&TIM1_handle);
+	__HAL_TIM_DISABLE(&engine->timHandle);
 
+	return HAL_OK;
 }
 
 
+static HAL_StatusTypeDef ws2812b_dma_slot_init(WS2812_Struct *engine, DMA_HandleTypeDef *hdma, uint32_t slot)
+{
+	const WS2812_TimerHw *hw = &timerHw[engine->timer];
 
-DMA_HandleTypeDef     dmaUpdate;
-DMA_HandleTypeDef     dmaCC1;
-DMA_HandleTypeDef     dmaCC2;
-#define BUFFER_SIZE		(sizeof(ws2812bDmaBitBuffer)/sizeof(uint16_t))
+	hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+#if defined(WS2812B_TWO_STREAMS)
+	if(slot == SLOT_DATA)
+	{
+		// Whole BSRR words, the set and the reset of every bit one after another
+		hdma->Init.MemInc = DMA_MINC_ENABLE;
+		hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+	} else {
+#else
+	if(slot == SLOT_DATA)
+	{
+		// Data are halfwords written to the upper reset half of BSRR
+		hdma->Init.MemInc = DMA_MINC_ENABLE;
+		hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+		hdma->Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+	} else {
+#endif
+		hdma->Init.MemInc = DMA_MINC_DISABLE;
+		hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+	}
+	hdma->Init.Mode = DMA_CIRCULAR;
+	hdma->Init.Priority = DMA_PRIORITY_VERY_HIGH;
+	hdma->Init.Channel = hw->dmaChannel[slot];
+
+	hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	hdma->Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+	hdma->Init.MemBurst = DMA_MBURST_SINGLE;
+	hdma->Init.PeriphBurst = DMA_PBURST_SINGLE;
+
+	hdma->Instance = hw->stream[slot];
+
+	HAL_DMA_DeInit(hdma);
+
+	if(slot == SLOT_IRQ)
+	{
+		hdma->XferCpltCallback  = DMA_TransferCompleteHandler;
+		hdma->XferHalfCpltCallback = DMA_TransferHalfHandler;
+		hdma->XferErrorCallback = DMA_TransferError;
+	}
 
-uint32_t dummy;
+	if(HAL_DMA_Init(hdma) != HAL_OK)
+		return HAL_ERROR;
 
+	// Callbacks find their engine through the parent
+	hdma->Parent = engine;
 
-static void DMA2_init(void)
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef ws2812b_dma_init(WS2812_Struct *engine)
 {
+	const WS2812_TimerHw *hw = &timerHw[engine->timer];
+	WS2812_DmaSource *source = &dmaSource[engine->timer];
+	uint32_t bsrr = (uint32_t)&engine->port->BSRR;
 
-	// TIM2 Update event
+	// Only DMA2 has access to the AHB1 bus with GPIOs
 	__HAL_RCC_DMA2_CLK_ENABLE();
 
-	dmaUpdate.Init.Direction = DMA_MEMORY_TO_PERIPH;
-	dmaUpdate.Init.PeriphInc = DMA_PINC_DISABLE;
-	dmaUpdate.Init.MemInc = DMA_MINC_DISABLE;
-	dmaUpdate.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
-	dmaUpdate.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
-	dmaUpdate.Init.Mode = DMA_CIRCULAR;
-	dmaUpdate.Init.Priority = DMA_PRIORITY_VERY_HIGH;
-	dmaUpdate.Init.Channel = DMA_CHANNEL_6;
+#if defined(WS2812B_TWO_STREAMS)
+	uint32_t i;
 
-	dmaUpdate.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
-	dmaUpdate.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
-	dmaUpdate.Init.MemBurst = DMA_MBURST_SINGLE;
-	dmaUpdate.Init.PeriphBurst = DMA_PBURST_SINGLE;
+	// The set words are constant, the data words are expanded from the bitbuffer
+	for( i = 0; i < engine->bitBufferSize; i++ )
+	{
+		source->bsrrWords[2 * i] = engine->ioHigh;
+		source->bsrrWords[2 * i + 1] = 0;
+	}
 
-	dmaUpdate.Instance = DMA2_Stream5;
-	//dmaUpdate.XferCpltCallback  = TransferComplete;
-	//dmaUpdate.XferErrorCallback = TransferError;
+	engine->dmaHigh.Instance = NULL;
 
-	HAL_DMA_DeInit(&dmaUpdate);
-	HAL_DMA_Init(&dmaUpdate);
-	//HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 0, 0);
-	//HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
-	HAL_DMA_Start(&dmaUpdate, (uint32_t)WS2812_IO_High, (uint32_t)(&WS2812B_PORT->BSRR), BUFFER_SIZE);
-	//HAL_DMA_Start(&dmaUpdate, (uint32_t)WS2812_IO_High, (uint32_t)&dummy, BUFFER_SIZE);
+	if(ws2812b_dma_slot_init(engine, &engine->dmaData, SLOT_DATA) != HAL_OK ||
+	   ws2812b_dma_slot_init(engine, &engine->dmaLow, SLOT_LOW) != HAL_OK)
+		return HAL_ERROR;
 
+	HAL_DMA_Start(&engine->dmaLow, (uint32_t)&source->ioLow, bsrr, engine->bitBufferSize);
 
-	// TIM2 CC1 event
-	dmaCC1.Init.Direction = DMA_MEMORY_TO_PERIPH;
-	dmaCC1.Init.PeriphInc = DMA_PINC_DISABLE;
-	dmaCC1.Init.MemInc = DMA_MINC_ENABLE;
-	dmaCC1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
-	dmaCC1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
-	dmaCC1.Init.Mode = DMA_CIRCULAR;
-	dmaCC1.Init.Priority = DMA_PRIORITY_VERY_HIGH;
-	dmaCC1.Init.Channel = DMA_CHANNEL_6;
+	HAL_NVIC_SetPriority(hw->dmaIrq, 0, 0);
+	HAL_NVIC_EnableIRQ(hw->dmaIrq);
+	HAL_DMA_Start_IT(&engine->dmaData, (uint32_t)source->bsrrWords, bsrr, 2 * engine->bitBufferSize);
+#else
+	if(ws2812b_dma_slot_init(engine, &engine->dmaHigh, SLOT_HIGH) != HAL_OK ||
+	   ws2812b_dma_slot_init(engine, &engine->dmaData, SLOT_DATA) != HAL_OK ||
+	   ws2812b_dma_slot_init(engine, &engine->dmaLow, SLOT_LOW) != HAL_OK)
+		return HAL_ERROR;
 
-	dmaCC1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
-	dmaCC1.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
-	dmaCC1.Init.MemBurst = DMA_MBURST_SINGLE;
-	dmaCC1.Init.PeriphBurst = DMA_PBURST_SINGLE;
+	HAL_DMA_Start(&engine->dmaHigh, (uint32_t)&source->ioHigh, bsrr, engine->bitBufferSize);
+	HAL_DMA_Start(&engine->dmaData, (uint32_t)engine->bitBuffer, bsrr + 2, engine->bitBufferSize); //BRR
 
-	dmaCC1.Instance = DMA2_Stream1;
-	//dmaUpdate.XferCpltCallback  = TransferComplete;
-	//dmaUpdate.XferErrorCallback = TransferError;
-	//dmaUpdate.XferHalfCpltCallback = TransferHalf;
-	//HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
-	//HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
-	HAL_DMA_DeInit(&dmaCC1);
-	HAL_DMA_Init(&dmaCC1);
-	HAL_DMA_Start(&dmaCC1, (uint32_t)ws2812bDmaBitBuffer, (uint32_t)(&WS2812B_PORT->BSRR) + 2, BUFFER_SIZE); //BRR
-	//HAL_DMA_Start(&dmaCC1, (uint32_t)ws2812bDmaBitBuffer, (uint32_t)&dummy, BUFFER_SIZE); //BRR
+	HAL_NVIC_SetPriority(hw->dmaIrq, 0, 0);
+	HAL_NVIC_EnableIRQ(hw->dmaIrq);
+	HAL_DMA_Start_IT(&engine->dmaLow, (uint32_t)&source->ioLow, bsrr, engine->bitBufferSize);
+#endif
 
+	return HAL_OK;
+}
 
-	// TIM2 CC2 event
-	dmaCC2.Init.Direction = DMA_MEMORY_TO_PERIPH;
-	dmaCC2.Init.PeriphInc = DMA_PINC_DISABLE;
-	dmaCC2.Init.MemInc = DMA_MINC_DISABLE;
-	dmaCC2.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
-	dmaCC2.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
-	dmaCC2.Init.Mode = DMA_CIRCULAR;
-	dmaCC2.Init.Priority = DMA_PRIORITY_VERY_HIGH;
-	dmaCC2.Init.Channel = DMA_CHANNEL_6;
 
-	dmaCC2.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
-	dmaCC2.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
-	dmaCC2.Init.MemBurst = DMA_MBURST_SINGLE;
-	dmaCC2.Init.PeriphBurst = DMA_PBURST_SINGLE;
 
-	dmaCC2.Instance = DMA2_Stream2;
 
-	HAL_DMA_DeInit(&dmaCC2);
+// Continue with the next segment, after the last one start from the first again
+static WS2812B_RAMFUNC void ws2812b_next_segment(WS2812_BufferItem *bItem)
+{
+	uint32_t index = bItem->segmentIndex + 1;
 
-	dmaCC2.XferCpltCallback  = DMA_TransferCompleteHandler;
-	dmaCC2.XferHalfCpltCallback = DMA_TransferHalfHandler;
-	dmaCC2.XferErrorCallback = DMA_TransferError;
+	if(index == bItem->segmentCount)
+		index = 0;
+
+	bItem->segmentIndex = index;
+	bItem->readPointer = bItem->segment[index].pointer;
+	bItem->readStep = bItem->segment[index].step;
+	bItem->readRemaining = bItem->segment[index].pixels;
+}
+
+// Encoded pattern of a single pixel for each framebuffer format, the inverted
+// wire word. The data DMA resets the outputs with the set bits, see ws2812b_set_pixel.
+static WS2812B_RAMFUNC uint32_t ws2812b_fetch_rgb(const WS2812_BufferItem *bItem, const uint8_t *p)
+{
+	return ~((gammaTable[p[1]] << 24) | (gammaTable[p[0]] << 16) | (gammaTable[p[2]] << 8));
+}
 
-	HAL_DMA_Init(&dmaCC2);
-	HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, 0, 0);
-	HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
-	HAL_DMA_Start_IT(&dmaCC2, (uint32_t)WS2812_IO_Low, (uint32_t)&WS2812B_PORT->BSRR, BUFFER_SIZE);
-	//HAL_DMA_Start_IT(&dmaCC2, (uint32_t)WS2812_IO_Low, (uint32_t)&dummy, BUFFER_SIZE);
+static WS2812B_RAMFUNC uint32_t ws2812b_fetch_xrgb(const WS2812_BufferItem *bItem, const uint8_t *p)
+{
+	return ws2812b_encode_color(*(const uint32_t *)p);
+}
 
-	//__HAL_LINKDMA(&Tim2Handle, hdma,  &dmaCC2);
+// Already in the wire order, single load and no repacking
+static WS2812B_RAMFUNC uint32_t ws2812b_fetch_grbx(const WS2812_BufferItem *bItem, const uint8_t *p)
+{
+	return ~*(const uint32_t *)p;
+}
 
+// Index load and palette load, the palette is already encoded
+static WS2812B_RAMFUNC uint32_t ws2812b_fetch_pal8(const WS2812_BufferItem *bItem, const uint8_t *p)
+{
+	return bItem->palette[(uint8_t)(*p + bItem->paletteOffset)];
 }
 
+// PAL4 pixels are addressed by nibbles, the pixel pointer is the framebuffer
+// pointer plus the pixel index, so the segments and steps work like with PAL8.
+static WS2812B_RAMFUNC uint32_t ws2812b_fetch_pal4(const WS2812_BufferItem *bItem, const uint8_t *p)
+{
+	uint32_t index = p - bItem->frameBufferPointer;
+	uint32_t value = bItem->frameBufferPointer[index >> 1];
 
+	value = (index & 1) ? value : value >> 4;
 
+	return bItem->palette[(value + bItem->paletteOffset) & 0x0F];
+}
 
+static uint32_t (* const formatFetch[])(const WS2812_BufferItem *bItem, const uint8_t *pixel) = {
+	ws2812b_fetch_rgb,	// WS2812B_FORMAT_RGB
+	ws2812b_fetch_xrgb,	// WS2812B_FORMAT_XRGB
+	ws2812b_fetch_grbx,	// WS2812B_FORMAT_GRBX
+	ws2812b_fetch_pal8,	// WS2812B_FORMAT_PAL8
+	ws2812b_fetch_pal4	// WS2812B_FORMAT_PAL4
+};
 
+static inline void ws2812b_advance(WS2812_BufferItem *bItem)
+{
+	bItem->readPointer += bItem->readStep;
+	if(--bItem->readRemaining == 0)
+		ws2812b_next_segment(bItem);
+}
 
-static void loadNextFramebufferData(WS2812_BufferItem *bItem, uint32_t row)
+// Pattern of the next LED for each framebuffer format. There is no wrap
+// compare, only the segment counter is decremented.
+static WS2812B_RAMFUNC uint32_t ws2812b_load_rgb(WS2812_BufferItem *bItem)
 {
+	uint32_t pattern = ws2812b_fetch_rgb(bItem, bItem->readPointer);
 
-	uint32_t r = bItem->frameBufferPointer[bItem->frameBufferCounter++];
-	uint32_t g = bItem->frameBufferPointer[bItem->frameBufferCounter++];
-	uint32_t b = bItem->frameBufferPointer[bItem->frameBufferCounter++];
+	ws2812b_advance(bItem);
+	return pattern;
+}
 
-	if(bItem->frameBufferCounter == bItem->frameBufferSize)
-		bItem->frameBufferCounter = 0;
+static WS2812B_RAMFUNC uint32_t ws2812b_load_xrgb(WS2812_BufferItem *bItem)
+{
+	uint32_t pattern = ws2812b_fetch_xrgb(bItem, bItem->readPointer);
 
-	ws2812b_set_pixel(bItem->channel, row, r, g, b);
+	ws2812b_advance(bItem);
+	return pattern;
 }
 
+static WS2812B_RAMFUNC uint32_t ws2812b_load_grbx(WS2812_BufferItem *bItem)
+{
+	uint32_t pattern = ws2812b_fetch_grbx(bItem, bItem->readPointer);
 
-// Transmit the framebuffer
-static void WS2812_sendbuf()
+	ws2812b_advance(bItem);
+	return pattern;
+}
+
+static WS2812B_RAMFUNC uint32_t ws2812b_load_pal8(WS2812_BufferItem *bItem)
 {
-	// transmission complete flag
-	ws2812b.transferComplete = 0;
+	uint32_t pattern = ws2812b_fetch_pal8(bItem, bItem->readPointer);
+
+	ws2812b_advance(bItem);
+	return pattern;
+}
 
+static WS2812B_RAMFUNC uint32_t ws2812b_load_pal4(WS2812_BufferItem *bItem)
+{
+	uint32_t pattern = ws2812b_fetch_pal4(bItem, bItem->readPointer);
+
+	ws2812b_advance(bItem);
+	return pattern;
+}
+
+// Next run of the RLE framebuffer, after the last one start from the first again
+static WS2812B_RAMFUNC void ws2812b_next_run(WS2812_BufferItem *bItem)
+{
+	const uint32_t *run = (const uint32_t *)bItem->readPointer;
+
+	if(bItem->runsLeft == 0)
+	{
+		run = (const uint32_t *)bItem->segment[0].pointer;
+		bItem->runsLeft = bItem->segment[0].pixels;
+	}
+
+	bItem->runPattern = ws2812b_encode_color(*run);
+	bItem->readRemaining = ((*run >> 24) - 1) & 0xFF;
+	bItem->readPointer = (const uint8_t *)(run + 1);
+	bItem->runsLeft--;
+}
+
+// The colour is encoded once per run, the LEDs of the run only return it
+static WS2812B_RAMFUNC uint32_t ws2812b_load_rle(WS2812_BufferItem *bItem)
+{
+	uint32_t pattern = bItem->runPattern;
+
+	if(bItem->readRemaining-- == 0)
+		ws2812b_next_run(bItem);
+
+	return pattern;
+}
+
+static uint32_t (* const formatLoader[])(WS2812_BufferItem *bItem) = {
+	ws2812b_load_rgb,	// WS2812B_FORMAT_RGB
+	ws2812b_load_xrgb,	// WS2812B_FORMAT_XRGB
+	ws2812b_load_grbx,	// WS2812B_FORMAT_GRBX
+	ws2812b_load_pal8,	// WS2812B_FORMAT_PAL8
+	ws2812b_load_pal4,	// WS2812B_FORMAT_PAL4
+	ws2812b_load_rle	// WS2812B_FORMAT_RLE
+};
+
+// Pointer step of one pixel, PAL4 steps by nibbles and RLE by runs
+static const uint8_t formatPixelSize[] = { 3, 4, 4, 1, 1, 4 };
+
+// Complete pixels in the framebuffer of the item
+static uint32_t ws2812b_item_pixels(const WS2812_BufferItem *bItem)
+{
+	if(bItem->format == WS2812B_FORMAT_PAL4)
+		return bItem->frameBufferSize * 2;
+
+	return bItem->frameBufferSize / formatPixelSize[bItem->format];
+}
+
+// Stretching, the nearest framebuffer pixel to the LED. The rounded up step and the
+// two extra loads of the bitbuffer halves run behind the end, the last pixel is held.
+static WS2812B_RAMFUNC uint32_t ws2812b_load_stretch(WS2812_BufferItem *bItem)
+{
+	uint32_t index = bItem->position >> 16;
+	uint32_t last = bItem->segment[0].pixels - 1;
+
+	if(index > last)
+		index = last;
+
+	bItem->position += bItem->positionStep;
+	return bItem->fetch(bItem, bItem->readPointer + index * bItem->readStep);
+}
+
+// Stretching, two neighbour pixels are blended. The wire words are already
+// gamma corrected, G and B are weighted together in two 16-bit lanes of one multiply.
+static WS2812B_RAMFUNC uint32_t ws2812b_load_stretch_linear(WS2812_BufferItem *bItem)
+{
+	uint32_t index = bItem->position >> 16;
+	uint32_t f = (bItem->position >> 8) & 0xFF;
+
+	bItem->position += bItem->positionStep;
+
+	// From the last pixel on there is no neighbour to blend with
+	if(index >= bItem->segment[0].pixels - 1)
+	{
+		index = bItem->segment[0].pixels - 1;
+		f = 0;
+	}
+
+	const uint8_t *p = bItem->readPointer + index * bItem->readStep;
+
+	if(f == 0)
+		return bItem->fetch(bItem, p);
+
+	uint32_t a = ~bItem->fetch(bItem, p) >> 8;
+	uint32_t b = ~bItem->fetch(bItem, p + bItem->readStep) >> 8;
+	uint32_t inv = 256 - f;
+	uint32_t gb = ((a & 0x00FF00FF) * inv + (b & 0x00FF00FF) * f) >> 8;
+	uint32_t r = (((a >> 8) & 0xFF) * inv + ((b >> 8) & 0xFF) * f) >> 8;
+
+	return ~(((gb & 0x00FF00FF) | (r << 8)) << 8);
+}
+
+// Precompute the segments of the item for the new frame and choose its loader
+static void ws2812b_segments_init(WS2812_BufferItem *bItem, uint32_t numberOfLeds)
+{
+	int32_t pixelSize = formatPixelSize[bItem->format];
+	uint32_t pixels = ws2812b_item_pixels(bItem);
+	uint32_t offset = bItem->frameBufferOffset % pixels;
+	const uint8_t *first = bItem->frameBufferPointer;
+	const uint8_t *last = first + (pixels - 1) * pixelSize;
+
+	bItem->load = formatLoader[bItem->format];
+	bItem->fetch = formatFetch[bItem->format];
+	bItem->halfPattern[0] = NO_PATTERN;
+	bItem->halfPattern[1] = NO_PATTERN;
+
+	if(bItem->format == WS2812B_FORMAT_RLE)
+	{
+		// Runs are decoded in the order, the read mode and the offset are not used
+		bItem->segment[0].pointer = first;
+		bItem->segment[0].pixels = pixels;
+		bItem->segmentCount = 1;
+		bItem->runsLeft = 0;
+		ws2812b_next_run(bItem);
+		return;
+	}
+
+	switch(bItem->readMode)
+	{
+	case WS2812B_READ_REVERSE:
+		// Rotated framebuffer backwards, from the pixel before the offset down to the start and then from the end
+		bItem->segment[0].pointer = offset ? first + (offset - 1) * pixelSize : last;
+		bItem->segment[0].pixels = offset ? offset : pixels;
+		bItem->segment[0].step = -pixelSize;
+		bItem->segment[1].pointer = last;
+		bItem->segment[1].pixels = pixels - offset;
+		bItem->segment[1].step = -pixelSize;
+		bItem->segmentCount = offset ? 2 : 1;
+		break;
+
+	case WS2812B_READ_MIRROR:
+		bItem->segment[0].pointer = first;
+		bItem->segment[0].pixels = pixels;
+		bItem->segment[0].step = pixelSize;
+		bItem->segment[1].pointer = last;
+		bItem->segment[1].pixels = pixels;
+		bItem->segment[1].step = -pixelSize;
+		bItem->segmentCount = 2;
+		break;
+
+	case WS2812B_READ_STRETCH:
+	case WS2812B_READ_STRETCH_LINEAR:
+		// The first pixel is on the first LED, linear stretching ends on the last pixel.
+		// The loaders clamp the index to the last pixel, the loads after the last LED
+		// and the rounded up nearest step would read behind the framebuffer.
+		bItem->segment[0].pointer = first;
+		bItem->segment[0].pixels = pixels;
+		bItem->segment[0].step = pixelSize;
+		bItem->segmentCount = 1;
+		bItem->position = 0;
+
+		if(bItem->readMode == WS2812B_READ_STRETCH)
+		{
+			// Rounded up, so the pixel borders are not shifted by the truncation
+			bItem->positionStep = ((pixels << 16) + numberOfLeds - 1) / numberOfLeds;
+			bItem->load = ws2812b_load_stretch;
+		} else {
+			bItem->positionStep = numberOfLeds > 1 ? ((pixels - 1) << 16) / (numberOfLeds - 1) : 0;
+			bItem->load = ws2812b_load_stretch_linear;
+		}
+		break;
+
+	default:
+		// Rotated framebuffer is read from the offset to the end and then from the start
+		bItem->segment[0].pointer = first + offset * pixelSize;
+		bItem->segment[0].pixels = pixels - offset;
+		bItem->segment[0].step = pixelSize;
+		bItem->segment[1].pointer = first;
+		bItem->segment[1].pixels = offset;
+		bItem->segment[1].step = pixelSize;
+		bItem->segmentCount = offset ? 2 : 1;
+		break;
+	}
+
+	bItem->segmentIndex = 0;
+	bItem->readPointer = bItem->segment[0].pointer;
+	bItem->readStep = bItem->segment[0].step;
+	bItem->readRemaining = bItem->segment[0].pixels;
+}
+
+#if !defined(SETPIX_TRANSPOSE)
+// The half still holds the LED loaded two LEDs ago. When the pattern is the same,
+// the channel bits are already there and the encoding is skipped.
+static inline void loadNextFramebufferData(WS2812_Struct *engine, WS2812_BufferItem *bItem, uint32_t row)
+{
+	uint32_t pattern = bItem->load(bItem) & 0xFFFFFF00;
+
+	if(pattern == bItem->halfPattern[row])
+		return;
+
+	bItem->halfPattern[row] = pattern;
+	ws2812b_set_pixel(engine->bitBuffer, bItem->channel, row, pattern);
+}
+
+// Default C bitbuffer filling, one LED of every item
+static WS2812B_RAMFUNC void ws2812b_load_half(WS2812_Struct *engine, uint32_t row)
+{
 	uint32_t i;
 
-	for( i = 0; i < WS2812_BUFFER_COUNT; i++ )
+	for( i = 0; i < engine->itemCount; i++ )
+	{
+		loadNextFramebufferData(engine, &engine->item[i], row);
+	}
+}
+#endif
+
+// Four bits of the pattern spread to the bit 0 of four halfwords, the MSB first
+static const uint32_t nibbleSpread[16][2] WS2812B_RAMDATA = {
+	{ 0x00000000, 0x00000000 }, { 0x00000000, 0x00010000 }, { 0x00000000, 0x00000001 }, { 0x00000000, 0x00010001 },
+	{ 0x00010000, 0x00000000 }, { 0x00010000, 0x00010000 }, { 0x00010000, 0x00000001 }, { 0x00010000, 0x00010001 },
+	{ 0x00000001, 0x00000000 }, { 0x00000001, 0x00010000 }, { 0x00000001, 0x00000001 }, { 0x00000001, 0x00010001 },
+	{ 0x00010001, 0x00000000 }, { 0x00010001, 0x00010000 }, { 0x00010001, 0x00000001 }, { 0x00010001, 0x00010001 }
+};
+
+// Bit-band free filling with plain word operations. Every nibble of the pattern is spread
+// by the table to four halfwords, shifted to the channel pin and merged with the other
+// items. The half is written once by 12 words without reading it, the pins without
+// an item stay zero. When no item changed, the half is left as it is.
+static WS2812B_RAMFUNC void ws2812b_load_half_transpose(WS2812_Struct *engine, uint32_t row)
+{
+	uint32_t columns[12] = { 0 };
+	uint32_t *half = (uint32_t *)&engine->bitBuffer[row * 24];
+	uint32_t changed = 0;
+	uint32_t i, k;
+
+	for( i = 0; i < engine->itemCount; i++ )
 	{
-		ws2812b.item[i].frameBufferCounter = 0;
+		WS2812_BufferItem *bItem = &engine->item[i];
+		uint32_t pattern = bItem->load(bItem) & 0xFFFFFF00;
+		uint32_t channel = bItem->channel;
+
+		changed |= pattern ^ bItem->halfPattern[row];
+		bItem->halfPattern[row] = pattern;
 
-		loadNextFramebufferData(&ws2812b.item[i], 0); // ROW 0
-		loadNextFramebufferData(&ws2812b.item[i], 1); // ROW 0
+		for( k = 0; k < 6; k++ )
+		{
+			const uint32_t *bits = nibbleSpread[(pattern >> (28 - 4 * k)) & 0x0F];
+
+			columns[2 * k] |= bits[0] << channel;
+			columns[2 * k + 1] |= bits[1] << channel;
+		}
 	}
 
-	// clear all DMA flags
-	__HAL_DMA_CLEAR_FLAG(&dmaUpdate, DMA_FLAG_TCIF1_5 | DMA_FLAG_HTIF1_5 | DMA_FLAG_TEIF1_5);
-	__HAL_DMA_CLEAR_FLAG(&dmaCC1, DMA_FLAG_TCIF1_5 | DMA_FLAG_HTIF1_5 | DMA_FLAG_TEIF1_5);
-	__HAL_DMA_CLEAR_FLAG(&dmaCC2, DMA_FLAG_TCIF2_6 | DMA_FLAG_HTIF2_6 | DMA_FLAG_TEIF2_6);
+	if(!changed)
+		return;
+
+	for( k = 0; k < 12; k++ )
+	{
+		half[k] = columns[k];
+	}
+}
+
+// Set the LED after the last one to zeros on every active pin. Data bits are inverted,
+// the set bit resets the output early, so the whole half is just the pin mask.
+static WS2812B_RAMFUNC void ws2812b_fill_tail(WS2812_Struct *engine, uint32_t row)
+{
+	uint32_t halfSize = engine->bitBufferSize / 2;
+	uint16_t *half = &engine->bitBuffer[row * halfSize];
+	uint16_t pins = engine->pins;
+	uint32_t i;
+
+	for( i = 0; i < halfSize; i++ )
+	{
+		half[i] = pins;
+	}
+}
+
+#if defined(WS2812B_TWO_STREAMS)
+// Copy the filled half of the bitbuffer to the reset halves of the BSRR data words
+static WS2812B_RAMFUNC void ws2812b_expand_half(WS2812_Struct *engine, uint32_t row)
+{
+	uint32_t halfSize = engine->bitBufferSize / 2;
+	const uint16_t *half = &engine->bitBuffer[row * halfSize];
+	uint32_t *words = &dmaSource[engine->timer].bsrrWords[2 * row * halfSize];
+	uint32_t i;
+
+	for( i = 0; i < halfSize; i++ )
+	{
+		words[2 * i + 1] = (uint32_t)half[i] << 16;
+	}
+}
+#endif
+
+// Check the item channels and derive the output pins from them
+static HAL_StatusTypeDef ws2812b_pinmap_init(WS2812_Struct *engine)
+{
+	uint16_t pins = 0;
+	uint32_t i;
+
+	for( i = 0; i < engine->itemCount; i++ )
+	{
+		WS2812_BufferItem *bItem = &engine->item[i];
+
+		// Only 16 pins on the port and only one item on each pin
+		if(bItem->channel > 15 || (pins & (1 << bItem->channel)))
+			return HAL_ERROR;
+
+		if(bItem->format > WS2812B_FORMAT_RLE || bItem->frameBufferPointer == NULL)
+			return HAL_ERROR;
+		if(bItem->readMode > WS2812B_READ_STRETCH_LINEAR)
+			return HAL_ERROR;
+		// The runs are read from the first one, there is no pixel offset into them
+		if(bItem->format == WS2812B_FORMAT_RLE && (bItem->readMode != WS2812B_READ_WRAP || bItem->frameBufferOffset != 0))
+			return HAL_ERROR;
+		if(bItem->format >= WS2812B_FORMAT_PAL8 && bItem->palette == NULL)
+			return HAL_ERROR;
+
+		// At least one pixel, the words have to be aligned
+		if(ws2812b_item_pixels(bItem) == 0)
+			return HAL_ERROR;
+		if(formatPixelSize[bItem->format] == 4 && ((uint32_t)bItem->frameBufferPointer & 0x03))
+			return HAL_ERROR;
+
+		pins |= 1 << bItem->channel;
+	}
 
+	engine->pins = pins;
+
+	return HAL_OK;
+}
+
+// Fill one half of the bitbuffer, with WS2812B_BENCHMARK the cycles are measured
+static inline void ws2812b_fill_half(WS2812_Struct *engine, uint32_t row)
+{
+#if defined(WS2812B_BENCHMARK)
+	uint32_t start = DWT->CYCCNT;
+#endif
 
+	engine->loadHalf(engine, row);
+
+#if defined(WS2812B_TWO_STREAMS)
+	ws2812b_expand_half(engine, row);
+#endif
+
+#if defined(WS2812B_BENCHMARK)
+	WS2812_Stats *stats = &engine->stats;
+	uint32_t cycles = DWT->CYCCNT - start;
+
+	stats->last = cycles;
+	if(cycles < stats->min)
+		stats->min = cycles;
+	if(cycles > stats->max)
+		stats->max = cycles;
+	stats->count++;
+	stats->total += cycles;
+#endif
+}
+
+// Clear transfer flags of the stream
+static void ws2812b_dma_clear_flags(DMA_HandleTypeDef *hdma)
+{
+	__HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TE_FLAG_INDEX(hdma));
+}
+
+
+// Transmit the framebuffer
+static void WS2812_sendbuf(WS2812_Struct *engine)
+{
+	const WS2812_TimerHw *hw = &timerHw[engine->timer];
+	TIM_HandleTypeDef *htim = &engine->timHandle;
+
+	// transmission complete flag
+	engine->transferComplete = 0;
+
+	uint32_t i;
+
+	for( i = 0; i < engine->itemCount; i++ )
+	{
+		ws2812b_segments_init(&engine->item[i], engine->numberOfLeds);
+	}
+
+	ws2812b_fill_half(engine, 0); // ROW 0
+	ws2812b_fill_half(engine, 1); // ROW 1
+
+	// clear all DMA flags
+	if(engine->dmaHigh.Instance)
+		ws2812b_dma_clear_flags(&engine->dmaHigh);
+	ws2812b_dma_clear_flags(&engine->dmaData);
+	ws2812b_dma_clear_flags(&engine->dmaLow);
 
 	// configure the number of bytes to be transferred by the DMA controller
-	dmaUpdate.Instance->NDTR = BUFFER_SIZE;
-	dmaCC1.Instance->NDTR = BUFFER_SIZE;
-	dmaCC2.Instance->NDTR = BUFFER_SIZE;
+	if(engine->dmaHigh.Instance)
+		engine->dmaHigh.Instance->NDTR = engine->bitBufferSize;
+#if defined(WS2812B_TWO_STREAMS)
+	engine->dmaData.Instance->NDTR = 2 * engine->bitBufferSize;
+#else
+	engine->dmaData.Instance->NDTR = engine->bitBufferSize;
+#endif
+	engine->dmaLow.Instance->NDTR = engine->bitBufferSize;
 
-	// clear all TIM2 flags
-	__HAL_TIM_CLEAR_FLAG(&TIM1_handle, TIM_FLAG_UPDATE | TIM_FLAG_CC1 | TIM_FLAG_CC2 | TIM_FLAG_CC3 | TIM_FLAG_CC4);
+	// clear all timer flags
+	__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE | TIM_FLAG_CC1 | TIM_FLAG_CC2 | TIM_FLAG_CC3 | TIM_FLAG_CC4);
 
 	// enable DMA channels
-	__HAL_DMA_ENABLE(&dmaUpdate);
-	__HAL_DMA_ENABLE(&dmaCC1);
-	__HAL_DMA_ENABLE(&dmaCC2);
+	if(engine->dmaHigh.Instance)
+		__HAL_DMA_ENABLE(&engine->dmaHigh);
+	__HAL_DMA_ENABLE(&engine->dmaData);
+	__HAL_DMA_ENABLE(&engine->dmaLow);
 
-	// IMPORTANT: enable the TIM2 DMA requests AFTER enabling the DMA channels!
-	__HAL_TIM_ENABLE_DMA(&TIM1_handle, TIM_DMA_UPDATE);
-	__HAL_TIM_ENABLE_DMA(&TIM1_handle, TIM_DMA_CC1);
-	__HAL_TIM_ENABLE_DMA(&TIM1_handle, TIM_DMA_CC2);
+	// IMPORTANT: enable the timer DMA requests AFTER enabling the DMA channels!
+	__HAL_TIM_ENABLE_DMA(htim, hw->dmaRequest[SLOT_HIGH]);
+	__HAL_TIM_ENABLE_DMA(htim, hw->dmaRequest[SLOT_DATA]);
+	__HAL_TIM_ENABLE_DMA(htim, hw->dmaRequest[SLOT_LOW]);
 
-	TIM1->CNT = tim_period-1;
+	htim->Instance->CNT = engine->timStart;
 
-	// start TIM2
-	__HAL_TIM_ENABLE(&TIM1_handle);
+	// start timer
+	__HAL_TIM_ENABLE(htim);
 }
 
 
@@ -303,84 +886,82 @@ void DMA_TransferError(DMA_HandleTypeDef *DmaHandle)
 }
 
 
-void DMA_TransferHalfHandler(DMA_HandleTypeDef *DmaHandle)
+WS2812B_RAMFUNC void DMA_TransferHalfHandler(DMA_HandleTypeDef *DmaHandle)
 {
+	WS2812_Struct *engine = DmaHandle->Parent;
 
 	// Is this the last LED?
-	if(ws2812b.repeatCounter == WS2812B_NUMBER_OF_LEDS)
+	if(engine->repeatCounter == engine->halfCount)
 	 {
 
 		// If this is the last pixel, set the next pixel value to zeros, because
 		// the DMA would not stop exactly at the last bit.
-		ws2812b_set_pixel(0, 0, 0, 0, 0);
+		ws2812b_fill_tail(engine, 0);
+#if defined(WS2812B_TWO_STREAMS)
+		ws2812b_expand_half(engine, 0);
+#endif
 
 	} else {
-		uint32_t i;
+		ws2812b_fill_half(engine, 0);
 
-		for( i = 0; i < WS2812_BUFFER_COUNT; i++ )
-		{
-			loadNextFramebufferData(&ws2812b.item[i], 0);
-		}
-
-		ws2812b.repeatCounter++;
+		engine->repeatCounter++;
 	}
 
 
 
 }
 
-void DMA_TransferCompleteHandler(DMA_HandleTypeDef *DmaHandle)
+WS2812B_RAMFUNC void DMA_TransferCompleteHandler(DMA_HandleTypeDef *DmaHandle)
 {
+	WS2812_Struct *engine = DmaHandle->Parent;
+	const WS2812_TimerHw *hw = &timerHw[engine->timer];
+	TIM_HandleTypeDef *htim = &engine->timHandle;
 
 	#if defined(LED_ORANGE_PORT)
 		LED_ORANGE_PORT->BSRR = LED_ORANGE_PIN;
 	#endif
 
-	if(ws2812b.repeatCounter == WS2812B_NUMBER_OF_LEDS)
+	if(engine->repeatCounter == engine->halfCount)
 	{
 		// Transfer of all LEDs is done, disable DMA but enable tiemr update IRQ to stop the 50us pulse
-		ws2812b.repeatCounter = 0;
+		engine->repeatCounter = 0;
 
 		// Stop timer
-		TIM1->CR1 &= ~TIM_CR1_CEN;
+		htim->Instance->CR1 &= ~TIM_CR1_CEN;
 
 		// Disable DMA
-		__HAL_DMA_DISABLE(&dmaUpdate);
-		__HAL_DMA_DISABLE(&dmaCC1);
-		__HAL_DMA_DISABLE(&dmaCC2);
+		if(engine->dmaHigh.Instance)
+			__HAL_DMA_DISABLE(&engine->dmaHigh);
+		__HAL_DMA_DISABLE(&engine->dmaData);
+		__HAL_DMA_DISABLE(&engine->dmaLow);
 
 		// Disable the DMA requests
-		__HAL_TIM_DISABLE_DMA(&TIM1_handle, TIM_DMA_UPDATE);
-		__HAL_TIM_DISABLE_DMA(&TIM1_handle, TIM_DMA_CC1);
-		__HAL_TIM_DISABLE_DMA(&TIM1_handle, TIM_DMA_CC2);
+		__HAL_TIM_DISABLE_DMA(htim, hw->dmaRequest[SLOT_HIGH]);
+		__HAL_TIM_DISABLE_DMA(htim, hw->dmaRequest[SLOT_DATA]);
+		__HAL_TIM_DISABLE_DMA(htim, hw->dmaRequest[SLOT_LOW]);
 
 		// Set 50us period for Treset pulse
-		//TIM2->PSC = 1000; // For this long period we need prescaler 1000
-		TIM1->ARR = timer_reset_pulse_period;
+		htim->Instance->ARR = engine->timResetPeriod;
 		// Reset the timer
-		TIM1->CNT = 0;
+		htim->Instance->CNT = 0;
 
 		// Generate an update event to reload the prescaler value immediately
-		TIM1->EGR = TIM_EGR_UG;
-		__HAL_TIM_CLEAR_FLAG(&TIM1_handle, TIM_FLAG_UPDATE);
+		htim->Instance->EGR = TIM_EGR_UG;
+		__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
 
-		// Enable TIM2 Update interrupt for 50us Treset signal
-		__HAL_TIM_ENABLE_IT(&TIM1_handle, TIM_IT_UPDATE);
+		// Enable timer Update interrupt for 50us Treset signal
+		__HAL_TIM_ENABLE_IT(htim, TIM_IT_UPDATE);
 		// Enable timer
-		TIM1->CR1 |= TIM_CR1_CEN;
+		htim->Instance->CR1 |= TIM_CR1_CEN;
 
 		// Manually set outputs to low to generate 50us reset impulse
-		WS2812B_PORT->BSRR = WS2812_IO_Low[0];
+		engine->port->BSRR = engine->ioLow;
 	} else {
 
 		// Load bitbuffer with next RGB LED values
-		uint32_t i;
-		for( i = 0; i < WS2812_BUFFER_COUNT; i++ )
-		{
-			loadNextFramebufferData(&ws2812b.item[i], 1);
-		}
+		ws2812b_fill_half(engine, 1);
 
-		ws2812b.repeatCounter++;
+		engine->repeatCounter++;
 	}
 
 
@@ -391,7 +972,7 @@ void DMA_TransferCompleteHandler(DMA_HandleTypeDef *DmaHandle)
 
 }
 
-void DMA2_Stream2_IRQHandler(void)
+static WS2812B_RAMFUNC void ws2812b_dma_irq(WS2812_Struct *engine)
 {
 
 	#if defined(LED_BLUE_PORT)
@@ -399,258 +980,486 @@ void DMA2_Stream2_IRQHandler(void)
 	#endif
 
 	// Check the interrupt and clear flag
-	  HAL_DMA_IRQHandler(&dmaCC2);
+#if defined(WS2812B_TWO_STREAMS)
+	  HAL_DMA_IRQHandler(&engine->dmaData);
+#else
+	  HAL_DMA_IRQHandler(&engine->dmaLow);
+#endif
 
 	#if defined(LED_BLUE_PORT)
 		LED_BLUE_PORT->BSRR = LED_BLUE_PIN << 16;
 	#endif
 }
 
-void TIM1_UP_TIM10_IRQHandler(void)
+static void ws2812b_tim_irq(WS2812_Struct *engine)
 {
 	#if defined(LED_ORANGE_PORT)
 		LED_ORANGE_PORT->BSRR = LED_ORANGE_PIN;
 	#endif
 
-	HAL_TIM_IRQHandler(&TIM1_handle);
+	HAL_TIM_IRQHandler(&engine->timHandle);
 
 	#if defined(LED_ORANGE_PORT)
 		LED_ORANGE_PORT->BSRR = LED_ORANGE_PIN << 16;
 	#endif
 }
 
-// TIM2 Interrupt Handler gets executed on every TIM2 Update if enabled
+#if defined(WS2812B_TWO_STREAMS)
+WS2812B_RAMFUNC void DMA2_Stream6_IRQHandler(void)
+#else
+WS2812B_RAMFUNC void DMA2_Stream2_IRQHandler(void)
+#endif
+{
+	ws2812b_dma_irq(engineOwner[WS2812B_TIM1]);
+}
+
+void TIM1_UP_TIM10_IRQHandler(void)
+{
+	ws2812b_tim_irq(engineOwner[WS2812B_TIM1]);
+}
+
+#if defined(WS2812B_USE_TIM8)
+#if defined(WS2812B_TWO_STREAMS)
+WS2812B_RAMFUNC void DMA2_Stream2_IRQHandler(void)
+#else
+WS2812B_RAMFUNC void DMA2_Stream7_IRQHandler(void)
+#endif
+{
+	ws2812b_dma_irq(engineOwner[WS2812B_TIM8]);
+}
+
+void TIM8_UP_TIM13_IRQHandler(void)
+{
+	ws2812b_tim_irq(engineOwner[WS2812B_TIM8]);
+}
+#endif
+
+// Timer Interrupt Handler gets executed on every timer Update if enabled
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
-	/*
-	// I have to wait 50us to generate Treset signal
-	if (ws2812b.timerPeriodCounter < (uint8_t)WS2812_RESET_PERIOD)
-	{
-		// count the number of timer periods
-		ws2812b.timerPeriodCounter++;
-	}
+	WS2812_Struct *engine;
+
+	// Other timers of the application may have the update callback too
+	if(htim->Instance == TIM1)
+		engine = engineOwner[WS2812B_TIM1];
+	else if(htim->Instance == TIM8)
+		engine = engineOwner[WS2812B_TIM8];
 	else
-	{
-		ws2812b.timerPeriodCounter = 0;
-		__HAL_TIM_DISABLE(&TIM1_handle);
-		TIM1->CR1 = 0; // disable timer
+		return;
 
-		// disable the TIM2 Update
-		__HAL_TIM_DISABLE_IT(&TIM1_handle, TIM_IT_UPDATE);
-		// set TransferComplete flag
-		ws2812b.transferComplete = 1;
-	}*/
+	// Update before the engine of the timer is initialized
+	if(engine == NULL)
+		return;
 
-    ws2812b.timerPeriodCounter = 0;
-    TIM1->CR1 = 0; // disable timer
+    engine->timerPeriodCounter = 0;
+    htim->Instance->CR1 = 0; // disable timer
 
-    // disable the TIM2 Update IRQ
-    __HAL_TIM_DISABLE_IT(&TIM1_handle, TIM_IT_UPDATE);
+    // disable the timer Update IRQ
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
 
     // Set back 1,25us period
-    TIM1->ARR = tim_period;
+    htim->Instance->ARR = engine->timPeriod;
 
     // Generate an update event to reload the Prescaler value immediatly
-    TIM1->EGR = TIM_EGR_UG;
-    __HAL_TIM_CLEAR_FLAG(&TIM1_handle, TIM_FLAG_UPDATE);
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
 
     // set transfer_complete flag
-    ws2812b.transferComplete = 1;
+    engine->transferComplete = 1;
 
 }
 
 
 
-static void ws2812b_set_pixel(uint8_t row, uint16_t column, uint8_t red, uint8_t green, uint8_t blue)
-{
-
-	// Apply gamma
-	red = gammaTable[red];
-	green = gammaTable[green];
-	blue = gammaTable[blue];
-
 
+#if !defined(SETPIX_TRANSPOSE)
+// Serialize one LED into the bitbuffer. The pattern is the inverted wire word,
+// G7..G0 R7..R0 B7..B0 in the bits 31..8, a set bit resets the output early.
+static WS2812B_RAMFUNC void ws2812b_set_pixel(uint16_t *bitBuffer, uint8_t row, uint16_t column, uint32_t pattern)
+{
 	uint32_t calcCol = (column*24);
-	uint32_t invRed = ~red;
-	uint32_t invGreen = ~green;
-	uint32_t invBlue = ~blue;
 
 
 #if defined(SETPIX_1)
 	uint8_t i;
-	uint32_t calcClearRow = ~((0x01<<row) << 0);
-	for (i = 0; i < 8; i++)
+	uint32_t calcClearRow = ~(0x01<<row);
+	for (i = 0; i < 24; i++)
 	{
-		// clear the data for pixel
-
-		ws2812bDmaBitBuffer[(calcCol+i)] &= calcClearRow;
-		ws2812bDmaBitBuffer[(calcCol+8+i)] &= calcClearRow;
-		ws2812bDmaBitBuffer[(calcCol+16+i)] &= calcClearRow;
-
-		// write new data for pixel
-		ws2812bDmaBitBuffer[(calcCol+i)] |= (((((invGreen)<<i) & 0x80)>>7)<<(row+0));
-		ws2812bDmaBitBuffer[(calcCol+8+i)] |= (((((invRed)<<i) & 0x80)>>7)<<(row+0));
-		ws2812bDmaBitBuffer[(calcCol+16+i)] |= (((((invBlue)<<i) & 0x80)>>7)<<(row+0));
+		// clear the data for pixel and write new data for pixel
+		bitBuffer[(calcCol+i)] = (bitBuffer[(calcCol+i)] & calcClearRow) | (((pattern >> (31-i)) & 0x01) << row);
 	}
 #elif defined(SETPIX_2)
 	uint8_t i;
-	for (i = 0; i < 8; i++)
+	for (i = 0; i < 24; i++)
 	{
 		// Set or clear the data for the pixel
-
-		if(((invGreen)<<i) & 0x80)
-			varSetBit(ws2812bDmaBitBuffer[(calcCol+i)], row);
-		else
-			varResetBit(ws2812bDmaBitBuffer[(calcCol+i)], row);
-
-		if(((invRed)<<i) & 0x80)
-			varSetBit(ws2812bDmaBitBuffer[(calcCol+8+i)], row);
-		else
-			varResetBit(ws2812bDmaBitBuffer[(calcCol+8+i)], row);
-
-		if(((invBlue)<<i) & 0x80)
-			varSetBit(ws2812bDmaBitBuffer[(calcCol+16+i)], row);
+		if((pattern << i) & 0x80000000)
+			varSetBit(bitBuffer[(calcCol+i)], row);
 		else
-			varResetBit(ws2812bDmaBitBuffer[(calcCol+16+i)], row);
-
+			varResetBit(bitBuffer[(calcCol+i)], row);
 	}
 #elif defined(SETPIX_3)
-	ws2812bDmaBitBuffer[(calcCol+0)] |= (((((invGreen)<<0) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+0)] |= (((((invRed)<<0) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+0)] |= (((((invBlue)<<0) & 0x80)>>7)<<row);
-
-	ws2812bDmaBitBuffer[(calcCol+1)] |= (((((invGreen)<<1) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+1)] |= (((((invRed)<<1) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+1)] |= (((((invBlue)<<1) & 0x80)>>7)<<row);
-
-	ws2812bDmaBitBuffer[(calcCol+2)] |= (((((invGreen)<<2) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+2)] |= (((((invRed)<<2) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+2)] |= (((((invBlue)<<2) & 0x80)>>7)<<row);
-
-	ws2812bDmaBitBuffer[(calcCol+3)] |= (((((invGreen)<<3) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+3)] |= (((((invRed)<<3) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+3)] |= (((((invBlue)<<3) & 0x80)>>7)<<row);
-
-	ws2812bDmaBitBuffer[(calcCol+4)] |= (((((invGreen)<<4) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+4)] |= (((((invRed)<<4) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+4)] |= (((((invBlue)<<4) & 0x80)>>7)<<row);
+	uint32_t calcClearRow = ~(0x01<<row);
+
+	#define SETPIX_3_BIT(i) bitBuffer[(calcCol+(i))] = (bitBuffer[(calcCol+(i))] & calcClearRow) | (((pattern >> (31-(i))) & 0x01) << row)
+	// GREEN
+	SETPIX_3_BIT(0);
+	SETPIX_3_BIT(1);
+	SETPIX_3_BIT(2);
+	SETPIX_3_BIT(3);
+	SETPIX_3_BIT(4);
+	SETPIX_3_BIT(5);
+	SETPIX_3_BIT(6);
+	SETPIX_3_BIT(7);
 
-	ws2812bDmaBitBuffer[(calcCol+5)] |= (((((invGreen)<<5) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+5)] |= (((((invRed)<<5) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+5)] |= (((((invBlue)<<5) & 0x80)>>7)<<row);
-
-	ws2812bDmaBitBuffer[(calcCol+6)] |= (((((invGreen)<<6) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+6)] |= (((((invRed)<<6) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+6)] |= (((((invBlue)<<6) & 0x80)>>7)<<row);
+	// RED
+	SETPIX_3_BIT(8);
+	SETPIX_3_BIT(9);
+	SETPIX_3_BIT(10);
+	SETPIX_3_BIT(11);
+	SETPIX_3_BIT(12);
+	SETPIX_3_BIT(13);
+	SETPIX_3_BIT(14);
+	SETPIX_3_BIT(15);
 
-	ws2812bDmaBitBuffer[(calcCol+7)] |= (((((invGreen)<<7) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+8+7)] |= (((((invRed)<<7) & 0x80)>>7)<<row);
-	ws2812bDmaBitBuffer[(calcCol+16+7)] |= (((((invBlue)<<7) & 0x80)>>7)<<row);
+	// BLUE
+	SETPIX_3_BIT(16);
+	SETPIX_3_BIT(17);
+	SETPIX_3_BIT(18);
+	SETPIX_3_BIT(19);
+	SETPIX_3_BIT(20);
+	SETPIX_3_BIT(21);
+	SETPIX_3_BIT(22);
+	SETPIX_3_BIT(23);
+
+	#undef SETPIX_3_BIT
 #elif defined(SETPIX_4)
 
 	// Bitband optimizations with pure increments, 5us interrupts
-	uint32_t *bitBand = BITBAND_SRAM(&ws2812bDmaBitBuffer[(calcCol)], row);
+	uint32_t *bitBand = BITBAND_SRAM(&bitBuffer[(calcCol)], row);
 
-	*bitBand =  (invGreen >> 7);
+	*bitBand = (pattern >> 31);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 6);
+	*bitBand = (pattern >> 30);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 5);
+	*bitBand = (pattern >> 29);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 4);
+	*bitBand = (pattern >> 28);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 3);
+	*bitBand = (pattern >> 27);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 2);
+	*bitBand = (pattern >> 26);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 1);
+	*bitBand = (pattern >> 25);
 	bitBand+=16;
 
-	*bitBand = (invGreen >> 0);
+	*bitBand = (pattern >> 24);
 	bitBand+=16;
 
 	// RED
-	*bitBand =  (invRed >> 7);
+	*bitBand = (pattern >> 23);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 6);
+	*bitBand = (pattern >> 22);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 5);
+	*bitBand = (pattern >> 21);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 4);
+	*bitBand = (pattern >> 20);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 3);
+	*bitBand = (pattern >> 19);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 2);
+	*bitBand = (pattern >> 18);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 1);
+	*bitBand = (pattern >> 17);
 	bitBand+=16;
 
-	*bitBand = (invRed >> 0);
+	*bitBand = (pattern >> 16);
 	bitBand+=16;
 
 	// BLUE
-	*bitBand =  (invBlue >> 7);
+	*bitBand = (pattern >> 15);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 6);
+	*bitBand = (pattern >> 14);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 5);
+	*bitBand = (pattern >> 13);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 4);
+	*bitBand = (pattern >> 12);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 3);
+	*bitBand = (pattern >> 11);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 2);
+	*bitBand = (pattern >> 10);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 1);
+	*bitBand = (pattern >> 9);
 	bitBand+=16;
 
-	*bitBand = (invBlue >> 0);
+	*bitBand = (pattern >> 8);
 	bitBand+=16;
 
+#elif defined(SETPIX_5)
+
+	// Cortex-M4 kernel, 12 words of the columns are loaded by LDM, the two bits of
+	// each word are inserted in registers and stored back by STM. RBIT puts the
+	// G7 first bit order to the bits 0..23, the even and odd bits are packed
+	// by PKHBT/PKHTB so one shifted AND extracts the pair for both halfwords.
+	uint32_t *words = (uint32_t *)&bitBuffer[calcCol];
+	uint32_t clear = 0x00010001 << row;
+	uint32_t pair = 0x00010001;
+	uint32_t shift = row;
+	uint32_t low, high, bits;
+
+	__asm volatile (
+		"rbit	%[low], %[pattern]\n\t"
+		"lsr	%[bits], %[low], #1\n\t"
+		"and	%[bits], %[bits], #0x55555555\n\t"	// odd bits
+		"and	%[low], %[low], #0x55555555\n\t"	// even bits
+		"lsl	%[high], %[bits], #4\n\t"
+		"pkhtb	%[high], %[high], %[low], asr #12\n\t"	// bits 12..23, even low, odd high
+		"pkhbt	%[low], %[low], %[bits], lsl #16\n\t"	// bits 0..11
+		"ldm	%[words], {r8-r11}\n\t"
+		"and	%[bits], %[pair], %[low]\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r8, r8, %[clear]\n\t"
+		"orr	r8, r8, %[bits]\n\t"
+		"and	%[bits], %[pair], %[low], lsr #2\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r9, r9, %[clear]\n\t"
+		"orr	r9, r9, %[bits]\n\t"
+		"and	%[bits], %[pair], %[low], lsr #4\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r10, r10, %[clear]\n\t"
+		"orr	r10, r10, %[bits]\n\t"
+		"and	%[bits], %[pair], %[low], lsr #6\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r11, r11, %[clear]\n\t"
+		"orr	r11, r11, %[bits]\n\t"
+		"stmia	%[words]!, {r8-r11}\n\t"
+		"ldm	%[words], {r8-r11}\n\t"
+		"and	%[bits], %[pair], %[low], lsr #8\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r8, r8, %[clear]\n\t"
+		"orr	r8, r8, %[bits]\n\t"
+		"and	%[bits], %[pair], %[low], lsr #10\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r9, r9, %[clear]\n\t"
+		"orr	r9, r9, %[bits]\n\t"
+		"and	%[bits], %[pair], %[high]\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r10, r10, %[clear]\n\t"
+		"orr	r10, r10, %[bits]\n\t"
+		"and	%[bits], %[pair], %[high], lsr #2\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r11, r11, %[clear]\n\t"
+		"orr	r11, r11, %[bits]\n\t"
+		"stmia	%[words]!, {r8-r11}\n\t"
+		"ldm	%[words], {r8-r11}\n\t"
+		"and	%[bits], %[pair], %[high], lsr #4\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r8, r8, %[clear]\n\t"
+		"orr	r8, r8, %[bits]\n\t"
+		"and	%[bits], %[pair], %[high], lsr #6\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r9, r9, %[clear]\n\t"
+		"orr	r9, r9, %[bits]\n\t"
+		"and	%[bits], %[pair], %[high], lsr #8\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r10, r10, %[clear]\n\t"
+		"orr	r10, r10, %[bits]\n\t"
+		"and	%[bits], %[pair], %[high], lsr #10\n\t"
+		"lsl	%[bits], %[bits], %[shift]\n\t"
+		"bic	r11, r11, %[clear]\n\t"
+		"orr	r11, r11, %[bits]\n\t"
+		"stmia	%[words]!, {r8-r11}"
+		: [words] "+r" (words), [low] "=&r" (low), [high] "=&r" (high), [bits] "=&r" (bits)
+		: [pattern] "r" (pattern), [pair] "r" (pair), [clear] "r" (clear), [shift] "r" (shift)
+		: "r8", "r9", "r10", "r11", "memory"
+	);
+
 #endif
 }
+#endif
 
 
-void ws2812b_init()
+HAL_StatusTypeDef ws2812b_engine_init(WS2812_Struct *engine)
 {
-	ws2812b_gpio_init();
+	if(engine->timer >= WS2812B_TIMER_COUNT || engineOwner[engine->timer] != NULL)
+		return HAL_ERROR;
 
-	/*TIM2_init();
-	DMA_init();*/
+	#if !defined(WS2812B_USE_TIM8)
+	if(engine->timer == WS2812B_TIM8)
+		return HAL_ERROR;
+	#endif
 
+	if(engine->itemCount == 0 || engine->itemCount > WS2812_BUFFER_COUNT)
+		engine->itemCount = WS2812_BUFFER_COUNT;
 
-	DMA2_init();
-	TIM1_init();
+	if(engine->bitBuffer == NULL)
+	{
+		engine->bitBuffer = dmaSource[engine->timer].bitBuffer;
+		engine->bitBufferSize = WS2812B_BITBUFFER_SIZE;
+	}
 
+	if(engine->loadHalf == NULL)
+	{
+#if defined(SETPIX_TRANSPOSE)
+		engine->loadHalf = ws2812b_load_half_transpose;
+#else
+		engine->loadHalf = ws2812b_load_half;
+#endif
+
+#if defined(SETPIX_BITBAND)
+		if(!BITBAND_REACHABLE(engine->bitBuffer))
+			engine->loadHalf = ws2812b_load_half_transpose;
+#endif
+
+		// The transpose and SETPIX_5 access the half by words
+#if defined(SETPIX_5)
+		if((uint32_t)engine->bitBuffer & 0x03)
+			return HAL_ERROR;
+#endif
+		if(engine->loadHalf == ws2812b_load_half_transpose && ((uint32_t)engine->bitBuffer & 0x03))
+			return HAL_ERROR;
+
+		if(ws2812b_pinmap_init(engine) != HAL_OK)
+			return HAL_ERROR;
+	}
+
+	if(engine->pins == 0)
+		return HAL_ERROR;
+
+	if(engine->halfCount == 0)
+		engine->halfCount = engine->numberOfLeds;
+
+#if defined(WS2812B_TWO_STREAMS)
+	// The BSRR words are expanded to the internal buffer of the timer
+	if(engine->bitBufferSize > WS2812B_BITBUFFER_SIZE)
+		return HAL_ERROR;
+#endif
+
+#if defined(WS2812B_BENCHMARK)
+	// Enable the DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	ws2812b_stats_reset(engine);
+#endif
+
+	// Source words for the constant DMAs
+	engine->ioHigh = engine->pins;
+	engine->ioLow = (uint32_t)engine->pins << 16;
+	dmaSource[engine->timer].ioHigh = engine->ioHigh;
+	dmaSource[engine->timer].ioLow = engine->ioLow;
+
+	engineOwner[engine->timer] = engine;
+
+	ws2812b_gpio_init(engine);
+
+	if(ws2812b_dma_init(engine) != HAL_OK || ws2812b_tim_init(engine) != HAL_OK)
+	{
+		engineOwner[engine->timer] = NULL;
+		return HAL_ERROR;
+	}
 
 	// Need to start the first transfer
-	ws2812b.transferComplete = 1;
+	engine->transferComplete = 1;
+
+	return HAL_OK;
 }
 
 
-void ws2812b_handle()
+void ws2812b_engine_handle(WS2812_Struct *engine)
+{
+	if(engine->startTransfer) {
+		engine->startTransfer = 0;
+		WS2812_sendbuf(engine);
+	}
+
+}
+
+
+// Shift the item content on the strip by the pixels, negative value scrolls back.
+// The framebuffer is not touched, only its reading starts elsewhere.
+// RLE items can not be scrolled, their offset stays zero.
+void ws2812b_item_scroll(WS2812_BufferItem *bItem, int32_t pixels)
+{
+	int32_t count = ws2812b_item_pixels(bItem);
+
+	if(bItem->format == WS2812B_FORMAT_RLE || count == 0)
+		return;
+
+	int32_t offset = ((int32_t)(bItem->frameBufferOffset % count) - pixels) % count;
+
+	if(offset < 0)
+		offset += count;
+
+	bItem->frameBufferOffset = offset;
+}
+
+
+// Wire word of the 0x00RRGGBB colour with the gamma applied. Use it to fill
+// GRBX framebuffers, the IRQ then sends the words as they are.
+// Runs in the DMA IRQ from the XRGB and RLE loaders, so it is in the RAM with them
+WS2812B_RAMFUNC uint32_t ws2812b_wire_color(uint32_t rgb)
+{
+	return (gammaTable[(rgb >> 8) & 0xFF] << 24) | (gammaTable[(rgb >> 16) & 0xFF] << 16) | (gammaTable[rgb & 0xFF] << 8);
+}
+
+// Encoded pattern of the 0x00RRGGBB colour, the form the bitbuffer encoder takes
+WS2812B_RAMFUNC uint32_t ws2812b_encode_color(uint32_t rgb)
+{
+	return ~ws2812b_wire_color(rgb);
+}
+
+// Encode the colours into the palette once when they change, the IRQ then
+// only copies the cached patterns into the bitbuffer
+void ws2812b_palette_encode(uint32_t *palette, const uint32_t *colors, uint32_t count)
 {
-	if(ws2812b.startTransfer) {
-		ws2812b.startTransfer = 0;
-		WS2812_sendbuf();
+	uint32_t i;
+
+	for( i = 0; i < count; i++ )
+	{
+		palette[i] = ws2812b_encode_color(colors[i]);
 	}
+}
+
 
+void ws2812b_stats_reset(WS2812_Struct *engine)
+{
+#if defined(WS2812B_BENCHMARK)
+	memset(&engine->stats, 0, sizeof(engine->stats));
+	engine->stats.min = 0xFFFFFFFF;
+#endif
+}
+
+
+HAL_StatusTypeDef ws2812b_init()
+{
+	ws2812b.timer = WS2812B_TIM1;
+	ws2812b.port = WS2812B_PORT;
+	ws2812b.numberOfLeds = WS2812B_NUMBER_OF_LEDS;
+	ws2812b.itemCount = WS2812_BUFFER_COUNT;
+
+	return ws2812b_engine_init(&ws2812b);
+}
+
+
+void ws2812b_handle()
+{
+	ws2812b_engine_handle(&ws2812b);
 }
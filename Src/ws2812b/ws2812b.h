@@ -16,25 +16,47 @@
 #define WS2812B_H_
 #include "ws2812b.h"
 
-// GPIO enable command
-#define WS2812B_GPIO_CLK_ENABLE() __HAL_RCC_GPIOC_CLK_ENABLE()
-// LED output port
+// Default engine ws2812b on TIM1
+// *******************************
+// LED output port, the output pins are derived from the channels of the items
 #define WS2812B_PORT GPIOC
-// LED output pins
-#define WS2812B_PINS (GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_3)
 // How many LEDs are in the series - only valid multiples by two
 #define WS2812B_NUMBER_OF_LEDS 60
 
-// Number of paralel output LED strips. Each has its own buffer.
+// Maximal number of paralel output LED strips of one engine. Each has its own buffer.
 // Supports up to 16 outputs on a single GPIO port
 #define WS2812_BUFFER_COUNT 4
 
+// Enable second engine timer TIM8, it takes DMA2 Stream 3, 4, 7 and their IRQ handlers
+#define WS2812B_USE_TIM8
+
+// Two DMA streams per engine instead of three, one of them writes 32-bit BSRR words.
+// TIM1 takes DMA2 Stream 5, 6 and TIM8 Stream 1, 2, so Stream 3, 4 and 7 are free.
+// The bus writes per bit stay at three and the DMA buffer takes 8 bytes per bit.
+//#define WS2812B_TWO_STREAMS
+
 // Choose one of the bit-juggling setpixel implementation
 // *******************************************************
+// Nothing chosen means SETPIX_4 on Cortex-M3/M4 and SETPIX_TRANSPOSE on the cores without bit-banding
 //#define SETPIX_1	// For loop, works everywhere, slow
 //#define SETPIX_2	// Bit band in a loop
 //#define SETPIX_3	// Like SETPIX_1 but with unrolled loop
-#define SETPIX_4	// Fastest copying using bit-banding
+//#define SETPIX_4	// Fastest copying using bit-banding
+//#define SETPIX_5	// Cortex-M4 assembly, word load, register insert and store, compare with SETPIX_4
+//#define SETPIX_TRANSPOSE	// No bit-banding, all items of the half are merged and written by words
+
+// Measure cycles of the bitbuffer filling in DMA IRQ with the DWT counter, see WS2812_Stats
+//#define WS2812B_BENCHMARK
+
+// Memory placement, needs the sections of STM32F407VG_FLASH.ld
+// ****************************************************************
+// DMA bitbuffers in SRAM2, so the DMA does not wait behind the CPU stack and data in SRAM1
+#define WS2812B_SRAM2_BITBUFFER
+// CPU only framebuffers and palettes marked WS2812B_CCMRAM in the CCM RAM, the DMA can not reach them
+#define WS2812B_CCMRAM_FRAMEBUFFERS
+// Bitbuffer filling code and gammaTable in SRAM1, compare with WS2812B_BENCHMARK,
+// the flash with the ART accelerator is often as fast
+#define WS2812B_IRQ_IN_RAM
 
 
 // DEBUG OUTPUT
@@ -49,35 +71,168 @@
 #define LED_ORANGE_PIN GPIO_PIN_13
 
 
-// Public functions
-// ****************
-void ws2812b_init();
-void ws2812b_handle();
-
 // Library structures
 // ******************
 // This value sets number of periods to generate 50uS Treset signal
 #define WS2812_RESET_PERIOD 50
 
+// DMA bitbuffer - buffer for 2 LEDs - two times 24 bits
+#define WS2812B_BITBUFFER_SIZE (24 * 2)
+
+// Section attributes, CCM RAM is for the CPU only data like framebuffers, the DMA can not reach it
+#if defined(WS2812B_SRAM2_BITBUFFER)
+#define WS2812B_SRAM2 __attribute__((section(".sram2")))
+#else
+#define WS2812B_SRAM2
+#endif
+
+#if defined(WS2812B_CCMRAM_FRAMEBUFFERS)
+#define WS2812B_CCMRAM __attribute__((section(".ccmram")))
+#else
+#define WS2812B_CCMRAM
+#endif
+
+#if defined(WS2812B_IRQ_IN_RAM)
+#define WS2812B_RAMFUNC __attribute__((section(".ramfunc")))
+#define WS2812B_RAMDATA __attribute__((section(".ramdata")))
+#else
+#define WS2812B_RAMFUNC
+#define WS2812B_RAMDATA
+#endif
+
+// Timers which can run an engine. Every timer has its own DMA2 streams
+// so the engines can run concurrently.
+typedef enum WS2812_Timer {
+	WS2812B_TIM1 = 0,	// DMA2 Stream 5 (UP), 1 (CC1), 2 (CC2), two streams: 5 (UP), 6 (CC1 and CC2)
+	WS2812B_TIM8,		// DMA2 Stream 3 (CC2), 4 (CC3), 7 (CC4), two streams: 1 (UP), 2 (CC1 and CC2)
+	WS2812B_TIMER_COUNT
+} WS2812_Timer;
+
+// Framebuffer formats
+typedef enum WS2812_Format {
+	WS2812B_FORMAT_RGB = 0,	// 3 bytes R, G, B per LED
+	WS2812B_FORMAT_XRGB,	// aligned 32-bit word 0x00RRGGBB per LED, gamma is applied
+	WS2812B_FORMAT_GRBX,	// aligned 32-bit word 0xGGRRBB00 per LED in the wire order, sent as it is without gamma
+	WS2812B_FORMAT_PAL8,	// 1 byte palette index per LED, 256 entry palette
+	WS2812B_FORMAT_PAL4,	// 4-bit palette index per LED, high nibble first, 16 entry palette
+	WS2812B_FORMAT_RLE		// aligned 32-bit runs (count << 24) | 0xRRGGBB, count 0 means 256 LEDs, only WRAP read mode
+} WS2812_Format;
+
+// Run of the RLE framebuffer, count LEDs of the 0x00RRGGBB colour
+#define WS2812B_RUN(count, rgb) ((((uint32_t)(count) & 0xFF) << 24) | ((rgb) & 0x00FFFFFF))
+
+// How the framebuffer is spread over the strip
+typedef enum WS2812_ReadMode {
+	WS2812B_READ_WRAP = 0,		// from the offset to the end and from the start again, short framebuffer repeats
+	WS2812B_READ_REVERSE,		// like WRAP, but from the last LED to the first one
+	WS2812B_READ_MIRROR,		// forward and then backwards, the offset is ignored
+	WS2812B_READ_STRETCH,		// scaled to the whole strip, nearest pixel, the offset is ignored
+	WS2812B_READ_STRETCH_LINEAR	// scaled to the whole strip, neighbour pixels are blended, the offset is ignored
+} WS2812_ReadMode;
+
+// Maximal number of framebuffer parts read one after another
+#define WS2812B_MAX_SEGMENTS 2
+
+// Continuous part of the framebuffer
+typedef struct WS2812_Segment {
+	const uint8_t *pointer;
+	uint32_t pixels;
+	int32_t step;		// bytes to the next pixel, negative reads backwards
+} WS2812_Segment;
+
 typedef struct WS2812_BufferItem {
 	uint8_t* frameBufferPointer;
-	uint32_t frameBufferSize;
-	uint32_t frameBufferCounter;
-	uint8_t channel;	// digital output pin/channel
+	uint32_t frameBufferSize;	// RAW size in bytes, incomplete last pixel is ignored
+	uint32_t frameBufferOffset;	// first sent pixel, rotates the framebuffer without copying
+	uint8_t channel;	// digital output pin/channel, GPIO_PIN_5 = 5
+	uint8_t format;		// WS2812_Format
+	uint8_t readMode;	// WS2812_ReadMode
+	const uint32_t *palette;	// PAL8 and PAL4 encoded colours, see ws2812b_palette_encode()
+	uint8_t paletteOffset;		// added to every index, rotate it for the colour cycling
+
+	// Set by the library when the transfer starts. The segments are read
+	// in the loop, so short framebuffer repeats over the whole strip.
+	uint32_t (*load)(struct WS2812_BufferItem *bItem);
+	uint32_t (*fetch)(const struct WS2812_BufferItem *bItem, const uint8_t *pixel);	// single pixel of the format, used by stretching
+	const uint8_t *readPointer;
+	int32_t readStep;
+	uint32_t readRemaining;		// pixels left in the current segment
+	uint32_t position;			// stretching, 16.16 fixed point pixel index
+	uint32_t positionStep;
+	uint32_t runPattern;		// RLE, encoded colour of the current run
+	uint32_t runsLeft;
+	uint32_t halfPattern[2];	// pattern already in each bitbuffer half, the same LED is not encoded again
+	uint8_t segmentIndex;
+	uint8_t segmentCount;
+	WS2812_Segment segment[WS2812B_MAX_SEGMENTS];
 } WS2812_BufferItem;
 
 
 
+// Cycles spent by filling one half of the bitbuffer
+typedef struct WS2812_Stats {
+	uint32_t last;
+	uint32_t min;
+	uint32_t max;
+	uint32_t count;
+	uint64_t total;
+} WS2812_Stats;
+
 typedef struct WS2812_Struct
 {
+	// Fill these before ws2812b_engine_init()
+	WS2812_Timer timer;
+	GPIO_TypeDef *port;
+	uint16_t pins;			// derived from the item channels, fill only with own loadHalf
+	uint32_t numberOfLeds;	// only valid multiples by two
+	uint8_t itemCount;		// used items, 0 means WS2812_BUFFER_COUNT
 	WS2812_BufferItem item[WS2812_BUFFER_COUNT];
+
+	// Optional bitbuffer filling, NULL means C implementation for the items above.
+	// Used by the C++ front end in ws2812b.hpp
+	void (*loadHalf)(struct WS2812_Struct *engine, uint32_t row);
+	uint16_t *bitBuffer;		// NULL means the internal bitbuffer of the timer, WS2812B_SRAM2
+	uint32_t bitBufferSize;		// halfwords in both halves
+	uint32_t halfCount;			// halves loaded in one frame, 0 means numberOfLeds
+
 	uint8_t transferComplete;
 	uint8_t startTransfer;
 	uint32_t timerPeriodCounter;
 	uint32_t repeatCounter;
+
+	// Engine peripherals
+	TIM_HandleTypeDef timHandle;
+	DMA_HandleTypeDef dmaHigh;	// set all outputs at the bit start
+	DMA_HandleTypeDef dmaData;	// reset outputs with zero bits
+	DMA_HandleTypeDef dmaLow;	// reset all outputs at the bit end
+	uint32_t ioHigh;
+	uint32_t ioLow;
+	uint32_t timPeriod;
+	uint32_t timResetPeriod;
+	uint32_t timStart;		// counter value before the first bit
+
+#if defined(WS2812B_BENCHMARK)
+	WS2812_Stats stats;
+#endif
 } WS2812_Struct;
 
-WS2812_Struct ws2812b;
+// Default engine, configured by the defines above
+extern WS2812_Struct ws2812b;
+
+extern const uint8_t gammaTable[];
+
+// Public functions
+// ****************
+HAL_StatusTypeDef ws2812b_init();
+void ws2812b_handle();
+
+HAL_StatusTypeDef ws2812b_engine_init(WS2812_Struct *engine);
+void ws2812b_engine_handle(WS2812_Struct *engine);
+void ws2812b_stats_reset(WS2812_Struct *engine);
+void ws2812b_item_scroll(WS2812_BufferItem *bItem, int32_t pixels);
+uint32_t ws2812b_wire_color(uint32_t rgb);
+uint32_t ws2812b_encode_color(uint32_t rgb);
+void ws2812b_palette_encode(uint32_t *palette, const uint32_t *colors, uint32_t count);
 
 // Bit band stuff
 #define RAM_BASE 0x20000000
@@ -91,7 +246,6 @@ WS2812_Struct ws2812b;
 #define varResetBit(var,bit) (Var_ResetBit_BB((uint32_t)&var,bit))
 #define varGetBit(var,bit) (Var_GetBit_BB((uint32_t)&var,bit))
 
-static void ws2812b_set_pixel(uint8_t row, uint16_t column, uint8_t red, uint8_t green, uint8_t blue);
 void DMA_TransferCompleteHandler(DMA_HandleTypeDef *DmaHandle);
 void DMA_TransferHalfHandler(DMA_HandleTypeDef *DmaHandle);
 void DMA_TransferError(DMA_HandleTypeDef *DmaHandle);
@@ -0,0 +1,327 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Optional C++ front end, everything is known at compile time
+
+  Licence: MIT License
+
+*/
+
+#ifndef WS2812B_HPP_
+#define WS2812B_HPP_
+
+extern "C" {
+#include "stm32f4xx_hal.h"
+#include "ws2812b.h"
+}
+
+// The engine is specialised for the port, pins, strip length, bits per pixel
+// and bitbuffer depth. Channel and bit loops are unrolled, the bit-band offsets
+// are constants and only the pins in the PinMap are encoded. Timer, DMA and
+// IRQ handling is shared with the C library.
+//
+// Usage:
+//
+//	WS2812_Struct engine;
+//	typedef ws2812::Engine<engine, GPIOC_BASE, ws2812::PinMap<0, 1, 2, 3>, 60> Strip;
+//
+//	Strip::setFrameBuffer(0, frameBuffer, sizeof(frameBuffer));
+//	...
+//	Strip::init();
+//	...
+//	if(Strip::transferComplete())
+//		Strip::startTransfer();
+//
+// Enable WS2812B_BENCHMARK in ws2812b.h to compare engine.stats with the C implementation,
+// the saving is not measured yet.
+
+// Bit-band encoder on Cortex-M3 and M4 like SETPIX_4 of the C engine, the other cores
+// and SETPIX_TRANSPOSE in ws2812b.h use the transpose by words
+#if !defined(SETPIX_TRANSPOSE) && ((__CORTEX_M == 3) || (__CORTEX_M == 4))
+#define WS2812B_HPP_BITBAND
+#endif
+
+namespace ws2812 {
+
+// Calls Op::step<0>() ... Op::step<N-1>(), the loop is always unrolled
+template <unsigned N>
+struct Unroll {
+	template <typename Op>
+	static inline __attribute__((always_inline)) void run(Op &op)
+	{
+		Unroll<N - 1>::run(op);
+		op.template step<N - 1>();
+	}
+};
+
+template <>
+struct Unroll<0> {
+	template <typename Op>
+	static inline __attribute__((always_inline)) void run(Op &) {}
+};
+
+// Pin of the channel I
+template <unsigned I, uint8_t... Pins>
+struct PinAt;
+
+template <uint8_t First, uint8_t... Rest>
+struct PinAt<0, First, Rest...> {
+	static const uint8_t value = First;
+};
+
+template <unsigned I, uint8_t First, uint8_t... Rest>
+struct PinAt<I, First, Rest...> {
+	static const uint8_t value = PinAt<I - 1, Rest...>::value;
+};
+
+// Output pins of the port, channel I is sent on the pin PinMap::Pin<I>::value
+template <uint8_t... Pins>
+struct PinMap;
+
+template <>
+struct PinMap<> {
+	static const unsigned count = 0;
+	static const uint16_t mask = 0;
+};
+
+template <uint8_t First, uint8_t... Rest>
+struct PinMap<First, Rest...> {
+	static_assert(First < 16, "GPIO port has only 16 pins");
+	static_assert((PinMap<Rest...>::mask & (1 << First)) == 0, "Pin is used twice");
+
+	static const unsigned count = 1 + sizeof...(Rest);
+	static const uint16_t mask = (1 << First) | PinMap<Rest...>::mask;
+
+	template <unsigned I>
+	struct Pin {
+		static_assert(I < count, "Channel is not in the pin map");
+		static const uint8_t value = PinAt<I, First, Rest...>::value;
+	};
+};
+
+template <WS2812_Struct &E, uint32_t PortBase, typename Pins, uint32_t Leds,
+		unsigned BitsPerPixel = 24, unsigned Depth = 1, WS2812_Timer Timer = WS2812B_TIM1>
+class Engine {
+public:
+	static_assert(BitsPerPixel == 24 || BitsPerPixel == 32, "GRB or GRBW pixels are supported");
+	static_assert(Depth > 0, "At least one LED in each half of the bitbuffer");
+	static_assert(Pins::count > 0, "No output pin");
+
+	static const unsigned channels = Pins::count;
+	static const unsigned bytesPerPixel = BitsPerPixel / 8;
+	static const unsigned bitBufferSize = 2 * Depth * BitsPerPixel;
+
+	// Every channel needs its framebuffer set before, like the items of the C engine
+	static HAL_StatusTypeDef init()
+	{
+		for(unsigned i = 0; i < channels; i++)
+		{
+			if(frameBuffer[i] == NULL)
+				return HAL_ERROR;
+		}
+
+		E.timer = Timer;
+		E.port = reinterpret_cast<GPIO_TypeDef *>(PortBase);
+		E.pins = Pins::mask;
+		E.numberOfLeds = Leds;
+		E.loadHalf = &loadHalfTranspose;
+		E.bitBuffer = BitBufferPointer<bitBufferSize == WS2812B_BITBUFFER_SIZE>::get();
+		E.bitBufferSize = bitBufferSize;
+		E.halfCount = (Leds + Depth - 1) / Depth;
+
+		if(ws2812b_engine_init(&E) != HAL_OK)
+			return HAL_ERROR;
+
+#if defined(WS2812B_HPP_BITBAND)
+		// The bitbuffer is known now, the bit-band alias covers only the first 1 MB of SRAM.
+		// No transfer runs yet, so the encoder can still change.
+		if((reinterpret_cast<uintptr_t>(E.bitBuffer) - RAM_BASE) < 0x100000)
+			E.loadHalf = &loadHalfBitBand;
+#endif
+
+		return HAL_OK;
+	}
+
+	// RGB or RGBW framebuffer of the channel, it wraps over when shorter than the strip.
+	// At least one pixel, the partial pixel at the end is not sent.
+	static HAL_StatusTypeDef setFrameBuffer(unsigned channel, const uint8_t *buffer, uint32_t size)
+	{
+		if(channel >= channels || buffer == NULL || size < bytesPerPixel)
+			return HAL_ERROR;
+
+		frameBufferSize[channel] = size - (size % bytesPerPixel);
+		frameBufferCounter[channel] = 0;
+		frameBuffer[channel] = buffer;
+
+		return HAL_OK;
+	}
+
+	static bool transferComplete()
+	{
+		return E.transferComplete;
+	}
+
+	static void startTransfer()
+	{
+		for(unsigned i = 0; i < channels; i++)
+			frameBufferCounter[i] = 0;
+
+		E.startTransfer = 1;
+		ws2812b_engine_handle(&E);
+	}
+
+private:
+	// Own bitbuffer of the engines larger than the internal one of the timer
+	static uint16_t bitBuffer[bitBufferSize] WS2812B_SRAM2 __attribute__((aligned(4)));
+
+	// GCC puts the template static members to .bss whatever their section attribute,
+	// so the engines of the internal size take the SRAM2 bitbuffer of the timer from
+	// ws2812b_engine_init() and the own one is not even instantiated
+	template <bool Internal, typename Unused = void>
+	struct BitBufferPointer {
+		static uint16_t *get() { return NULL; }
+	};
+
+	template <typename Unused>
+	struct BitBufferPointer<false, Unused> {
+		static uint16_t *get() { return bitBuffer; }
+	};
+	static const uint8_t *frameBuffer[channels];
+	static uint32_t frameBufferSize[channels];
+	static uint32_t frameBufferCounter[channels];
+
+	// Next pixel of the channel in the wire order G, R, B (, W), gamma applied and inverted
+	template <unsigned Channel>
+	static inline __attribute__((always_inline)) uint32_t nextPixel()
+	{
+		const uint8_t *p = frameBuffer[Channel] + frameBufferCounter[Channel];
+		uint32_t wire = (gammaTable[p[1]] << 16) | (gammaTable[p[0]] << 8) | gammaTable[p[2]];
+
+		if(BitsPerPixel == 32)
+			wire = (wire << 8) | gammaTable[p[3]];
+
+		frameBufferCounter[Channel] += bytesPerPixel;
+		if(frameBufferCounter[Channel] == frameBufferSize[Channel])
+			frameBufferCounter[Channel] = 0;
+
+		return ~wire;
+	}
+
+#if defined(WS2812B_HPP_BITBAND)
+	// One bit of the pixel into its bit-band alias, the offset is a constant
+	template <unsigned Pin, unsigned Column>
+	struct EncodeBits {
+		volatile uint32_t *alias;
+		uint32_t inv;
+
+		template <unsigned Bit>
+		inline __attribute__((always_inline)) void step()
+		{
+			alias[(Column * BitsPerPixel + Bit) * 16 + Pin] = inv >> (BitsPerPixel - 1 - Bit);
+		}
+	};
+
+	template <unsigned Column>
+	struct EncodeChannels {
+		volatile uint32_t *alias;
+
+		template <unsigned Channel>
+		inline __attribute__((always_inline)) void step()
+		{
+			EncodeBits<Pins::template Pin<Channel>::value, Column> bits = { alias, nextPixel<Channel>() };
+			Unroll<BitsPerPixel>::run(bits);
+		}
+	};
+
+	struct EncodeColumns {
+		volatile uint32_t *alias;
+
+		template <unsigned Column>
+		inline __attribute__((always_inline)) void step()
+		{
+			EncodeChannels<Column> channel = { alias };
+			Unroll<channels>::run(channel);
+		}
+	};
+
+	static void loadHalfBitBand(WS2812_Struct *, uint32_t row)
+	{
+		uint16_t *half = &E.bitBuffer[row * (bitBufferSize / 2)];
+		EncodeColumns columns = { BITBAND_SRAM(half, 0) };
+
+		Unroll<Depth>::run(columns);
+	}
+#endif
+
+	// Two bits of the pixel into the bit 0 and 16 of the word, shifted to the pin.
+	// The word holds the halfwords of the bits Word * 2 and Word * 2 + 1, the MSB first.
+	template <unsigned Pin, unsigned Column>
+	struct TransposeBits {
+		uint32_t *words;
+		uint32_t inv;
+
+		template <unsigned Word>
+		inline __attribute__((always_inline)) void step()
+		{
+			uint32_t low = (inv >> (BitsPerPixel - 1 - 2 * Word)) & 1;
+			uint32_t high = (inv >> (BitsPerPixel - 2 - 2 * Word)) & 1;
+
+			words[Column * (BitsPerPixel / 2) + Word] |= (low | (high << 16)) << Pin;
+		}
+	};
+
+	template <unsigned Column>
+	struct TransposeChannels {
+		uint32_t *words;
+
+		template <unsigned Channel>
+		inline __attribute__((always_inline)) void step()
+		{
+			TransposeBits<Pins::template Pin<Channel>::value, Column> bits = { words, nextPixel<Channel>() };
+			Unroll<BitsPerPixel / 2>::run(bits);
+		}
+	};
+
+	struct TransposeColumns {
+		uint32_t *words;
+
+		template <unsigned Column>
+		inline __attribute__((always_inline)) void step()
+		{
+			TransposeChannels<Column> channel = { words };
+			Unroll<channels>::run(channel);
+		}
+	};
+
+	// Bit-band free, the channels are merged in a local copy and the half is written
+	// once by words. The pins out of the map stay zero.
+	static void loadHalfTranspose(WS2812_Struct *, uint32_t row)
+	{
+		uint32_t words[bitBufferSize / 4] = { 0 };
+		uint32_t *half = reinterpret_cast<uint32_t *>(&E.bitBuffer[row * (bitBufferSize / 2)]);
+		TransposeColumns columns = { words };
+
+		Unroll<Depth>::run(columns);
+
+		for(unsigned i = 0; i < bitBufferSize / 4; i++)
+			half[i] = words[i];
+	}
+};
+
+// Word aligned for the transpose, every half has an even number of halfwords
+template <WS2812_Struct &E, uint32_t PortBase, typename Pins, uint32_t Leds, unsigned BitsPerPixel, unsigned Depth, WS2812_Timer Timer>
+uint16_t Engine<E, PortBase, Pins, Leds, BitsPerPixel, Depth, Timer>::bitBuffer[bitBufferSize] WS2812B_SRAM2 __attribute__((aligned(4)));
+
+template <WS2812_Struct &E, uint32_t PortBase, typename Pins, uint32_t Leds, unsigned BitsPerPixel, unsigned Depth, WS2812_Timer Timer>
+const uint8_t *Engine<E, PortBase, Pins, Leds, BitsPerPixel, Depth, Timer>::frameBuffer[channels];
+
+template <WS2812_Struct &E, uint32_t PortBase, typename Pins, uint32_t Leds, unsigned BitsPerPixel, unsigned Depth, WS2812_Timer Timer>
+uint32_t Engine<E, PortBase, Pins, Leds, BitsPerPixel, Depth, Timer>::frameBufferSize[channels];
+
+template <WS2812_Struct &E, uint32_t PortBase, typename Pins, uint32_t Leds, unsigned BitsPerPixel, unsigned Depth, WS2812_Timer Timer>
+uint32_t Engine<E, PortBase, Pins, Leds, BitsPerPixel, Depth, Timer>::frameBufferCounter[channels];
+
+} // namespace ws2812
+
+#endif /* WS2812B_HPP_ */
@@ -0,0 +1,189 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Host benchmark of the word fade kernels against the per-byte loops, three
+  framebuffers of 960 bytes like 320 RGB LEDs each. The outputs have to be equal.
+
+  gcc -O2 -fno-tree-vectorize -w -ISrc/effects test/fade_bench.c -o fade_bench && ./fade_bench
+
+  The host vectorizer would turn the per-byte loops to SIMD, the Cortex-M4 has
+  none for them. On the host fade_subtract is the portable C, on the target
+  it is __UQSUB8, so its host speed-up is the smallest one.
+
+  Licence: MIT License
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Src/effects/fade.c"
+
+#define BUFFER_COUNT 3
+#define BUFFER_SIZE 960
+#define ROUNDS 20000
+
+// One spare word, the buffers are also tried from the unaligned starts
+static uint32_t buffers[BUFFER_COUNT][BUFFER_SIZE / 4 + 1];
+static uint32_t references[BUFFER_COUNT][BUFFER_SIZE / 4 + 1];
+
+// Runtime divisor, so the compiler can not turn the reference into a shift
+static volatile uint32_t divisor = 256;
+static uint32_t failures;
+
+// Per-byte loop of the same exponential decay with the division
+static void reference_scale(uint8_t *buffer, uint32_t size, uint8_t scale)
+{
+	uint32_t d = divisor;
+	uint32_t i;
+
+	for( i = 0; i < size; i++)
+		buffer[i] = (buffer[i] * (scale + 1)) / d;
+}
+
+static void reference_subtract(uint8_t *buffer, uint32_t size, uint8_t amount)
+{
+	uint32_t i;
+
+	for( i = 0; i < size; i++)
+	{
+		if(buffer[i] > amount)
+			buffer[i] -= amount;
+		else
+			buffer[i] = 0;
+	}
+}
+
+// The fade of the original dots effect, only timed, its curve is different
+static void original_dots_fade(uint8_t *buffer, uint32_t size, uint32_t fadeOutFactor)
+{
+	uint32_t i;
+
+	for( i = 0; i < size; i++)
+	{
+		if(buffer[i] > fadeOutFactor)
+			buffer[i] -= buffer[i] / fadeOutFactor;
+		else
+			buffer[i] = 0;
+	}
+}
+
+static void fill(uint32_t seed)
+{
+	uint32_t b, i;
+
+	for( b = 0; b < BUFFER_COUNT; b++)
+	{
+		for( i = 0; i < sizeof(buffers[b]); i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			((uint8_t *)buffers[b])[i] = seed >> 24;
+		}
+	}
+
+	memcpy(references, buffers, sizeof(buffers));
+}
+
+static double now_us(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static void compare(const char *name, uint32_t parameter, uint32_t offset)
+{
+	if(memcmp(buffers, references, sizeof(buffers)) != 0)
+	{
+		printf("%s %u offset %u differs\n", name, parameter, offset);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	uint32_t parameter, offset, b, r;
+	double start, word, byte, original;
+
+	// Every parameter and every alignment of the start, several fades in a row
+	for( parameter = 0; parameter < 256; parameter++)
+	{
+		for( offset = 0; offset < 4; offset++)
+		{
+			fill(parameter * 4 + offset);
+			for( r = 0; r < 4; r++)
+			{
+				for( b = 0; b < BUFFER_COUNT; b++)
+				{
+					fade_scale((uint8_t *)buffers[b] + offset, BUFFER_SIZE, parameter);
+					reference_scale((uint8_t *)references[b] + offset, BUFFER_SIZE, parameter);
+				}
+			}
+			compare("fade_scale", parameter, offset);
+
+			fill(parameter * 4 + offset + 1024);
+			for( r = 0; r < 4; r++)
+			{
+				for( b = 0; b < BUFFER_COUNT; b++)
+				{
+					fade_subtract((uint8_t *)buffers[b] + offset, BUFFER_SIZE, parameter);
+					reference_subtract((uint8_t *)references[b] + offset, BUFFER_SIZE, parameter);
+				}
+			}
+			compare("fade_subtract", parameter, offset);
+		}
+	}
+
+	// Timing, the buffers are refilled between the kernels so all see the same data
+	fill(1);
+	start = now_us();
+	for( r = 0; r < ROUNDS; r++)
+		for( b = 0; b < BUFFER_COUNT; b++)
+			fade_scale((uint8_t *)buffers[b], BUFFER_SIZE, 249);
+	word = now_us() - start;
+
+	fill(1);
+	start = now_us();
+	for( r = 0; r < ROUNDS; r++)
+		for( b = 0; b < BUFFER_COUNT; b++)
+			reference_scale((uint8_t *)buffers[b], BUFFER_SIZE, 249);
+	byte = now_us() - start;
+
+	fill(1);
+	start = now_us();
+	for( r = 0; r < ROUNDS; r++)
+		for( b = 0; b < BUFFER_COUNT; b++)
+			original_dots_fade((uint8_t *)buffers[b], BUFFER_SIZE, 40);
+	original = now_us() - start;
+
+	printf("fade_scale      %8.3f us per frame, per-byte divide %8.3f us, %.1fx\n", word / ROUNDS, byte / ROUNDS, byte / word);
+	printf("original dots   %8.3f us per frame, %.1fx\n", original / ROUNDS, original / word);
+
+	fill(1);
+	start = now_us();
+	for( r = 0; r < ROUNDS; r++)
+		for( b = 0; b < BUFFER_COUNT; b++)
+			fade_subtract((uint8_t *)buffers[b], BUFFER_SIZE, 8);
+	word = now_us() - start;
+
+	fill(1);
+	start = now_us();
+	for( r = 0; r < ROUNDS; r++)
+		for( b = 0; b < BUFFER_COUNT; b++)
+			reference_subtract((uint8_t *)buffers[b], BUFFER_SIZE, 8);
+	byte = now_us() - start;
+
+	printf("fade_subtract   %8.3f us per frame, per-byte loop   %8.3f us, %.1fx\n", word / ROUNDS, byte / ROUNDS, byte / word);
+
+	if(failures)
+	{
+		printf("fade_bench failed %u\n", failures);
+		return 1;
+	}
+
+	printf("fade_bench passed\n");
+	return 0;
+}
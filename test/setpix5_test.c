@@ -0,0 +1,253 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Host test of the SETPIX_5 inline assembly. The host can not run it, so the
+  instruction lines are read from Src/ws2812b/ws2812b.c and executed by a model
+  of the few Cortex-M4 instructions they use. The result is compared with the
+  SETPIX_1 encoding of the same pixel, the other pins have to stay untouched.
+
+  Run it from the repository root:
+  gcc test/setpix5_test.c -o setpix5_test && ./setpix5_test
+
+  Licence: MIT License
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE "Src/ws2812b/ws2812b.c"
+#define MAX_LINES 128
+
+// Operand names of the asm statement, then the fixed registers of the LDM/STM
+enum { R_WORDS, R_LOW, R_HIGH, R_BITS, R_PATTERN, R_PAIR, R_CLEAR, R_SHIFT, R8, R9, R10, R11, R_COUNT };
+
+static const char * const registerNames[R_COUNT] = {
+	"%[words]", "%[low]", "%[high]", "%[bits]", "%[pattern]", "%[pair]", "%[clear]", "%[shift]", "r8", "r9", "r10", "r11"
+};
+
+static char lines[MAX_LINES][96];
+static uint32_t lineCount;
+static uint32_t failures;
+
+// Instruction strings between "#elif defined(SETPIX_5)" and the operand list
+static int load_asm(void)
+{
+	char text[256];
+	int inside = 0;
+	FILE *f = fopen(SOURCE, "r");
+
+	if(f == NULL)
+		return 0;
+
+	while(fgets(text, sizeof(text), f))
+	{
+		char *start, *end;
+
+		if(strstr(text, "#elif defined(SETPIX_5)"))
+			inside = 1;
+		if(!inside)
+			continue;
+		if(strstr(text, ": [words]"))
+			break;
+
+		start = strchr(text, '"');
+		if(start == NULL || strstr(text, "__asm"))
+			continue;
+		end = strchr(start + 1, '"');
+		if(end == NULL || lineCount == MAX_LINES)
+			continue;
+
+		*end = 0;
+		if((end = strstr(start + 1, "\\n")) != NULL)
+			*end = 0;
+
+		strncpy(lines[lineCount++], start + 1, sizeof(lines[0]) - 1);
+	}
+
+	fclose(f);
+	return lineCount > 0;
+}
+
+static int register_index(const char *name)
+{
+	int i;
+
+	for( i = 0; i < R_COUNT; i++ )
+	{
+		if(strcmp(name, registerNames[i]) == 0)
+			return i;
+	}
+
+	printf("unknown register %s\n", name);
+	exit(1);
+}
+
+static uint32_t rbit(uint32_t x)
+{
+	uint32_t r = 0;
+	int i;
+
+	for( i = 0; i < 32; i++ )
+		r |= ((x >> i) & 1) << (31 - i);
+
+	return r;
+}
+
+// Third operand, the immediate, the register or the shifted register
+static uint32_t operand(char *text, uint32_t *regs)
+{
+	char name[32], kind[8];
+	unsigned amount;
+
+	if(text[0] == '#')
+		return strtoul(text + 1, NULL, 0);
+
+	if(sscanf(text, "%31[^ ,], %7s #%u", name, kind, &amount) == 3)
+	{
+		uint32_t value = regs[register_index(name)];
+
+		if(strcmp(kind, "lsr") == 0)
+			return value >> amount;
+		if(strcmp(kind, "lsl") == 0)
+			return value << amount;
+		if(strcmp(kind, "asr") == 0)
+			return (uint32_t)((int32_t)value >> amount);
+
+		printf("unknown shift %s\n", kind);
+		exit(1);
+	}
+
+	return regs[register_index(text)];
+}
+
+static void run(uint32_t *regs, uint32_t *memory)
+{
+	uint32_t l;
+	int i;
+
+	for( l = 0; l < lineCount; l++ )
+	{
+		char op[8], a[32], b[32], rest[64] = "";
+		char *line = lines[l];
+		int n;
+
+		// The comments are outside the strings, the fields are separated by tabs
+		while(*line == ' ')
+			line++;
+
+		if(sscanf(line, "%7s %31[^,], {r8-r11}", op, a) == 2 && (strcmp(op, "ldm") == 0 || strcmp(op, "stmia") == 0))
+		{
+			int writeBack = a[strlen(a) - 1] == '!';
+			uint32_t *words;
+
+			if(writeBack)
+				a[strlen(a) - 1] = 0;
+			words = &memory[regs[register_index(a)] / 4];
+
+			for( i = 0; i < 4; i++ )
+			{
+				if(op[0] == 'l')
+					regs[R8 + i] = words[i];
+				else
+					words[i] = regs[R8 + i];
+			}
+
+			if(writeBack)
+				regs[register_index(a)] += 16;
+			continue;
+		}
+
+		n = sscanf(line, "%7s %31[^,], %31[^,], %63[^\n]", op, a, b, rest);
+		if(n < 3)
+		{
+			printf("can not parse %s\n", line);
+			exit(1);
+		}
+
+		int d = register_index(a);
+		uint32_t x = regs[register_index(b)];
+		uint32_t y = n == 4 ? operand(rest, regs) : 0;
+
+		if(strcmp(op, "rbit") == 0)
+			regs[d] = rbit(x);
+		else if(strcmp(op, "lsr") == 0)
+			regs[d] = x >> y;
+		else if(strcmp(op, "lsl") == 0)
+			regs[d] = x << y;
+		else if(strcmp(op, "and") == 0)
+			regs[d] = x & y;
+		else if(strcmp(op, "bic") == 0)
+			regs[d] = x & ~y;
+		else if(strcmp(op, "orr") == 0)
+			regs[d] = x | y;
+		else if(strcmp(op, "pkhtb") == 0)
+			regs[d] = (x & 0xFFFF0000) | (y & 0x0000FFFF);
+		else if(strcmp(op, "pkhbt") == 0)
+			regs[d] = (x & 0x0000FFFF) | (y & 0xFFFF0000);
+		else
+		{
+			printf("unknown instruction %s\n", op);
+			exit(1);
+		}
+	}
+}
+
+static uint32_t random_next(uint32_t *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+int main(void)
+{
+	static uint32_t memory[24], expected[24];
+	uint16_t *actualHalves = (uint16_t *)memory;
+	uint16_t *expectedHalves = (uint16_t *)expected;
+	uint32_t seed = 1;
+	uint32_t t, i;
+
+	if(!load_asm())
+	{
+		printf("setpix5_test: no SETPIX_5 assembly in " SOURCE ", run it from the repository root\n");
+		return 1;
+	}
+
+	for( t = 0; t < 20000; t++ )
+	{
+		uint32_t regs[R_COUNT] = { 0 };
+		uint32_t pattern = random_next(&seed) & 0xFFFFFF00;
+		uint32_t row = random_next(&seed) & 0x0F;
+		uint32_t column = random_next(&seed) & 1;
+
+		for( i = 0; i < 48; i++ )
+			actualHalves[i] = expectedHalves[i] = random_next(&seed);
+
+		// SETPIX_1
+		for( i = 0; i < 24; i++ )
+			expectedHalves[column * 24 + i] = (expectedHalves[column * 24 + i] & ~(1 << row)) | (((pattern >> (31 - i)) & 1) << row);
+
+		// The inputs as ws2812b_set_pixel() prepares them
+		regs[R_WORDS] = column * 48;
+		regs[R_PATTERN] = pattern;
+		regs[R_PAIR] = 0x00010001;
+		regs[R_CLEAR] = 0x00010001 << row;
+		regs[R_SHIFT] = row;
+
+		run(regs, memory);
+
+		if(memcmp(memory, expected, sizeof(memory)) != 0)
+		{
+			printf("FAIL case %u pattern %08x row %u column %u\n", t, pattern, row, column);
+			failures++;
+		}
+	}
+
+	printf(failures ? "setpix5_test failed\n" : "setpix5_test passed, %u instructions\n", lineCount);
+	return failures ? 1 : 0;
+}
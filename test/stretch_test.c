@@ -0,0 +1,99 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Host test of the stretch read modes, every load stays inside the framebuffer
+
+  gcc -DUSE_HAL_DRIVER -DSTM32F407xx -D__weak= -D__packed= -w -ISrc -ISrc/ws2812b -IInc
+      -IDrivers/STM32F4xx_HAL_Driver/Inc -IDrivers/CMSIS/Device/ST/STM32F4xx/Include
+      -IDrivers/CMSIS/Include test/stretch_test.c -o stretch_test && ./stretch_test
+
+  Licence: MIT License
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../Src/ws2812b/ws2812b.c"
+
+// HAL functions used by the engine, nothing is run on the host
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t source, uint32_t destination, uint32_t length) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t source, uint32_t destination, uint32_t length) { return HAL_OK; }
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {}
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {}
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *config, uint32_t channel) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t channel) { return HAL_OK; }
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim) {}
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t sub) {}
+void HAL_NVIC_EnableIRQ(IRQn_Type irq) {}
+uint32_t SystemCoreClock = 168000000;
+
+static uint32_t (*formatFetchChecked)(const WS2812_BufferItem *bItem, const uint8_t *pixel);
+static uint32_t failures;
+
+// The fetch of the format, but every pixel address is checked first
+static uint32_t fetch_checked(const WS2812_BufferItem *bItem, const uint8_t *pixel)
+{
+	const uint8_t *end = bItem->frameBufferPointer + bItem->frameBufferSize;
+
+	if(pixel < bItem->frameBufferPointer || pixel + formatPixelSize[bItem->format] > end)
+	{
+		failures++;
+		return 0;
+	}
+
+	return formatFetchChecked(bItem, pixel);
+}
+
+// One frame of the engine is numberOfLeds + 2 loads, the DMA double buffer loads two halves ahead
+static void stretch_check(uint8_t readMode, uint32_t pixels, uint32_t numberOfLeds)
+{
+	uint8_t *frameBuffer = malloc(pixels * 3);
+	WS2812_BufferItem bItem = { 0 };
+	uint32_t before = failures;
+	uint32_t i;
+
+	for( i = 0; i < pixels * 3; i++ )
+		frameBuffer[i] = i;
+
+	bItem.frameBufferPointer = frameBuffer;
+	bItem.frameBufferSize = pixels * 3;
+	bItem.format = WS2812B_FORMAT_RGB;
+	bItem.readMode = readMode;
+
+	ws2812b_segments_init(&bItem, numberOfLeds);
+	formatFetchChecked = bItem.fetch;
+	bItem.fetch = fetch_checked;
+
+	for( i = 0; i < numberOfLeds + 2; i++ )
+		bItem.load(&bItem);
+
+	if(failures != before)
+		printf("FAIL %s %u pixels over %u LEDs\n", readMode == WS2812B_READ_STRETCH ? "nearest" : "linear", pixels, numberOfLeds);
+
+	free(frameBuffer);
+}
+
+int main(void)
+{
+	static const uint32_t pixels[] = { 1, 2, 3, 7, 20, 60, 120 };
+	static const uint32_t leds[] = { 2, 60, 120, 1000 };
+	uint32_t i, j;
+
+	for( i = 0; i < sizeof(pixels) / sizeof(pixels[0]); i++ )
+	{
+		for( j = 0; j < sizeof(leds) / sizeof(leds[0]); j++ )
+		{
+			stretch_check(WS2812B_READ_STRETCH, pixels[i], leds[j]);
+			stretch_check(WS2812B_READ_STRETCH_LINEAR, pixels[i], leds[j]);
+		}
+	}
+
+	printf(failures ? "stretch_test failed\n" : "stretch_test passed\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+
+  WS2812B CPU and memory efficient library
+
+  Host test of the SETPIX_TRANSPOSE encoder against the model of SETPIX_1,
+  every stream bit of every item lands on its pin in the right halfword
+
+  gcc -DUSE_HAL_DRIVER -DSTM32F407xx -D__weak= -D__packed= -w -ISrc -ISrc/ws2812b -IInc
+      -IDrivers/STM32F4xx_HAL_Driver/Inc -IDrivers/CMSIS/Device/ST/STM32F4xx/Include
+      -IDrivers/CMSIS/Include test/transpose_test.c -o transpose_test && ./transpose_test
+
+  Licence: MIT License
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../Src/ws2812b/ws2812b.c"
+
+// HAL functions used by the engine, nothing is run on the host
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t source, uint32_t destination, uint32_t length) { return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t source, uint32_t destination, uint32_t length) { return HAL_OK; }
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {}
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {}
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *config, uint32_t channel) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) { return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t channel) { return HAL_OK; }
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim) {}
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t sub) {}
+void HAL_NVIC_EnableIRQ(IRQn_Type irq) {}
+uint32_t SystemCoreClock = 168000000;
+
+static uint32_t patterns[WS2812_BUFFER_COUNT];
+static uint32_t failures;
+
+static uint32_t load_pattern(WS2812_BufferItem *bItem)
+{
+	return patterns[bItem - ws2812b.item];
+}
+
+// SETPIX_1, bit i of the stream (G7 first) clears and sets the pin in the halfword i of the half
+static void setpix_model(uint16_t *bitBuffer, uint32_t row, uint32_t channel, uint32_t pattern)
+{
+	uint16_t *half = &bitBuffer[row * 24];
+	uint32_t i;
+
+	for( i = 0; i < 24; i++ )
+	{
+		half[i] &= ~(1 << channel);
+		half[i] |= ((pattern >> (31 - i)) & 1) << channel;
+	}
+}
+
+static uint32_t random_next(uint32_t *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+int main(void)
+{
+	static uint32_t expected[24], actual[24];
+	uint16_t *expectedHalves = (uint16_t *)expected;
+	uint16_t *actualHalves = (uint16_t *)actual;
+	uint32_t seed = 1;
+	uint32_t t, i;
+
+	ws2812b.bitBuffer = actualHalves;
+	ws2812b.bitBufferSize = WS2812B_BITBUFFER_SIZE;
+
+	for( t = 0; t < 20000; t++ )
+	{
+		uint32_t row = random_next(&seed) & 1;
+		uint32_t pins = 0;
+
+		ws2812b.itemCount = 1 + random_next(&seed) % WS2812_BUFFER_COUNT;
+
+		// The other half keeps its content, the pins without an item are zero in this one
+		for( i = 0; i < 48; i++ )
+		{
+			actualHalves[i] = random_next(&seed);
+			expectedHalves[i] = (i / 24 == row) ? 0 : actualHalves[i];
+		}
+
+		for( i = 0; i < ws2812b.itemCount; i++ )
+		{
+			WS2812_BufferItem *bItem = &ws2812b.item[i];
+			uint32_t channel;
+
+			do
+				channel = random_next(&seed) & 0x0F;
+			while(pins & (1 << channel));
+			pins |= 1 << channel;
+
+			bItem->channel = channel;
+			bItem->load = load_pattern;
+			bItem->halfPattern[0] = NO_PATTERN;
+			bItem->halfPattern[1] = NO_PATTERN;
+			patterns[i] = random_next(&seed);
+
+			setpix_model(expectedHalves, row, channel, patterns[i] & 0xFFFFFF00);
+		}
+
+		ws2812b_load_half_transpose(&ws2812b, row);
+
+		for( i = 0; i < 48; i++ )
+		{
+			if(actualHalves[i] != expectedHalves[i])
+			{
+				printf("FAIL case %u halfword %u: %04x, expected %04x\n", t, i, actualHalves[i], expectedHalves[i]);
+				failures++;
+				break;
+			}
+		}
+
+		// The same patterns again, the half is not written
+		actualHalves[row * 24] ^= 0x8000;
+		ws2812b_load_half_transpose(&ws2812b, row);
+		if(actualHalves[row * 24] != (expectedHalves[row * 24] ^ 0x8000))
+		{
+			printf("FAIL case %u: unchanged patterns rewrote the half\n", t);
+			failures++;
+		}
+	}
+
+	printf(failures ? "transpose_test failed\n" : "transpose_test passed\n");
+	return failures ? 1 : 0;
+}